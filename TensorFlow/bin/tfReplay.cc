@@ -0,0 +1,189 @@
+/*
+ * Replays runs captured with tensorflow::RunCapture against a model at full speed and reports
+ * timings, so that TensorFlow versions and threading configurations can be compared with recorded
+ * production inputs.
+ * Usage:
+ *   tfReplay CAPTURE_FILE MODEL [--threads N] [--pool NAME] [--streams N] [--repeat N]
+ *                               [--session NAME] [--tag TAG]
+ * where MODEL is either a constant graph (.pb) or a SavedModel directory.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace {
+
+  void printUsage(const char* program) {
+    std::cerr << "usage: " << program << " CAPTURE_FILE MODEL [--threads N] [--pool NAME] [--streams N] [--repeat N]"
+              << " [--session NAME] [--tag TAG]" << std::endl
+              << "  MODEL      constant graph (.pb) or SavedModel directory" << std::endl
+              << "  --threads  number of threads of the session, default 1" << std::endl
+              << "  --pool     thread pool, 'no_threads' (default), 'tbb' or 'tensorflow'" << std::endl
+              << "  --streams  number of concurrent replay streams, default 1" << std::endl
+              << "  --repeat   number of passes over all captured runs, default 1" << std::endl
+              << "  --session  only replay runs captured for this session name, required when runs of" << std::endl
+              << "             multiple sessions were captured" << std::endl
+              << "  --tag      SavedModel tag, default 'serve'" << std::endl;
+  }
+
+  double percentile(std::vector<double> values, double q) {
+    if (values.empty()) {
+      return 0.;
+    }
+    size_t i = std::min(values.size() - 1, size_t(q * values.size()));
+    std::nth_element(values.begin(), values.begin() + i, values.end());
+    return values[i];
+  }
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  std::string capturePath = argv[1];
+  std::string modelPath = argv[2];
+
+  try {
+    // parse options, invalid numbers are reported by the exception handler below
+    int nThreads = 1;
+    std::string threadPoolName = "no_threads";
+    int nStreams = 1;
+    int nRepeat = 1;
+    std::string sessionName;
+    std::string tag = tensorflow::kSavedModelTagServe;
+    for (int i = 3; i < argc; i++) {
+      std::string arg = argv[i];
+      if (i + 1 >= argc) {
+        printUsage(argv[0]);
+        return 1;
+      }
+      std::string value = argv[++i];
+      if (arg == "--threads") {
+        nThreads = std::stoi(value);
+      } else if (arg == "--pool") {
+        threadPoolName = value;
+      } else if (arg == "--streams") {
+        nStreams = std::max(1, std::stoi(value));
+      } else if (arg == "--repeat") {
+        nRepeat = std::max(1, std::stoi(value));
+      } else if (arg == "--session") {
+        sessionName = value;
+      } else if (arg == "--tag") {
+        tag = value;
+      } else {
+        printUsage(argv[0]);
+        return 1;
+      }
+    }
+
+    tensorflow::setLogging();
+
+    // read all captured runs upfront so that file io does not enter the timing
+    std::vector<tensorflow::CapturedRun> capturedRuns;
+    std::set<std::string> sessionNames;
+    tensorflow::RunCaptureReader reader(capturePath);
+    tensorflow::CapturedRun capturedRun;
+    while (reader.next(&capturedRun)) {
+      if (sessionName.empty() || capturedRun.sessionName == sessionName) {
+        capturedRuns.push_back(capturedRun);
+        sessionNames.insert(capturedRun.sessionName);
+      }
+    }
+    if (capturedRuns.empty()) {
+      std::cerr << "no runs to replay in " << capturePath << std::endl;
+      return 1;
+    }
+
+    // all runs are replayed against a single model, so runs of different sessions cannot be mixed
+    if (sessionNames.size() > 1) {
+      std::cerr << "runs of " << sessionNames.size() << " sessions captured in " << capturePath
+                << ", select one of them with --session:";
+      for (const std::string& name : sessionNames) {
+        std::cerr << " " << name;
+      }
+      std::cerr << std::endl;
+      return 1;
+    }
+
+    // create the session from either a constant graph or a SavedModel
+    std::unique_ptr<tensorflow::GraphDef> graphDef;
+    std::unique_ptr<tensorflow::MetaGraphDef> metaGraphDef;
+    tensorflow::Session* session;
+    if (tensorflow::Env::Default()->IsDirectory(modelPath).ok()) {
+      metaGraphDef.reset(tensorflow::loadMetaGraphDef(modelPath, tag));
+      session = tensorflow::createSession(metaGraphDef.get(), modelPath, nThreads);
+    } else {
+      graphDef.reset(tensorflow::loadGraphDef(modelPath));
+      session = tensorflow::createSession(graphDef.get(), nThreads);
+    }
+
+    // warm up with the first run to exclude one-time initialization
+    std::vector<tensorflow::Tensor> warmupOutputs;
+    tensorflow::run(
+        session, capturedRuns[0].inputs, capturedRuns[0].outputNames, &warmupOutputs, threadPoolName);
+
+    // replay all runs, concurrently in a task arena when more than one stream is requested
+    size_t nRuns = capturedRuns.size() * nRepeat;
+    std::vector<double> durations(nRuns);
+    auto replay = [&](size_t i) {
+      const tensorflow::CapturedRun& r = capturedRuns[i % capturedRuns.size()];
+      std::vector<tensorflow::Tensor> outputs;
+      auto start = std::chrono::steady_clock::now();
+      tensorflow::run(session, r.inputs, r.outputNames, &outputs, threadPoolName);
+      durations[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto start = std::chrono::steady_clock::now();
+    if (nStreams == 1) {
+      for (size_t i = 0; i < nRuns; i++) {
+        replay(i);
+      }
+    } else {
+      tbb::task_arena arena(nStreams);
+      arena.execute([&] { tbb::parallel_for(size_t(0), nRuns, replay); });
+    }
+    double wallTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    tensorflow::closeSession(session);
+
+    // compare to the durations at capture time
+    double capturedTime = 0.;
+    for (const tensorflow::CapturedRun& r : capturedRuns) {
+      capturedTime += r.durationNs * 1.e-3;
+    }
+    double replayedTime = 0.;
+    for (double d : durations) {
+      replayedTime += d;
+    }
+    double capturedMean = capturedTime / capturedRuns.size();
+    double replayedMean = replayedTime / nRuns;
+
+    std::cout << std::fixed << std::setprecision(2) << "replayed runs   : " << nRuns << " (" << capturedRuns.size()
+              << " captured x " << nRepeat << ")" << std::endl
+              << "captured mean   : " << capturedMean << " us" << std::endl
+              << "replayed mean   : " << replayedMean << " us" << std::endl
+              << "replayed median : " << percentile(durations, 0.5) << " us" << std::endl
+              << "replayed p99    : " << percentile(durations, 0.99) << " us" << std::endl
+              << "speedup         : " << (replayedMean > 0. ? capturedMean / replayedMean : 0.) << std::endl
+              << "throughput      : " << (wallTime > 0. ? nRuns / wallTime * 1.e6 : 0.) << " runs/s" << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
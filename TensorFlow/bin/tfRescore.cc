@@ -0,0 +1,262 @@
+/*
+ * Evaluates a model on all rows of a columnar input file and writes its outputs to a columnar output
+ * file, without the framework. Batches are streamed through a TBB pipeline so that reading ahead,
+ * packing and inference of different batches overlap across cores, and outputs are written
+ * directly into the memory-mapped output file.
+ * Usage:
+ *   tfRescore INPUT_FILE MODEL OUTPUT_FILE --input NAME --output NAME [--features A,B,...]
+ *             [--columns X,Y,...] [--scalar NAME=VALUE] [--batch N] [--streams N] [--threads N]
+ *             [--pool NAME] [--tag TAG]
+ * where MODEL is either a constant graph (.pb) or a SavedModel directory. Columnar files can be
+ * created and read in python with write_columnar_file and read_columnar_file of
+ * PhysicsTools.TensorFlow.tools.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/pipeline.h"
+#include "tbb/task_arena.h"
+
+#include "PhysicsTools/TensorFlow/interface/ColumnarFile.h"
+#include "PhysicsTools/TensorFlow/interface/FeaturePacker.h"
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace {
+
+  void printUsage(const char* program) {
+    std::cerr << "usage: " << program << " INPUT_FILE MODEL OUTPUT_FILE --input NAME --output NAME [options]"
+              << std::endl
+              << "  MODEL       constant graph (.pb) or SavedModel directory" << std::endl
+              << "  --input     name of the input tensor of shape {batch, features}" << std::endl
+              << "  --output    name of the output tensor of shape {batch} or {batch, columns}" << std::endl
+              << "  --features  comma-separated input columns in input order, default all" << std::endl
+              << "  --columns   comma-separated names of output columns, default <output>_<i>" << std::endl
+              << "  --scalar    additional scalar float input NAME=VALUE, can be repeated" << std::endl
+              << "  --batch     rows per batch, default 4096" << std::endl
+              << "  --streams   number of batches in flight, default the number of cores" << std::endl
+              << "  --threads   number of threads of the session, default 1" << std::endl
+              << "  --pool      thread pool, 'no_threads' (default), 'tbb' or 'tensorflow'" << std::endl
+              << "  --tag       SavedModel tag, default 'serve'" << std::endl;
+  }
+
+  std::vector<std::string> split(const std::string& s) {
+    std::vector<std::string> parts;
+    std::stringstream ss(s);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+      if (!part.empty()) {
+        parts.push_back(part);
+      }
+    }
+    return parts;
+  }
+
+  // half-open range of rows processed as one batch
+  struct Batch {
+    size_t start;
+    size_t end;
+  };
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  std::string inputPath = argv[1];
+  std::string modelPath = argv[2];
+  std::string outputPath = argv[3];
+  std::string inputName, outputName;
+  std::vector<std::string> featureNames, columnNames;
+  tensorflow::NamedTensorList scalars;
+  size_t batchSize = 4096;
+  int nStreams = tbb::this_task_arena::max_concurrency();
+  int nThreads = 1;
+  std::string threadPoolName = "no_threads";
+  std::string tag = tensorflow::kSavedModelTagServe;
+  for (int i = 4; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--input") {
+      inputName = value;
+    } else if (arg == "--output") {
+      outputName = value;
+    } else if (arg == "--features") {
+      featureNames = split(value);
+    } else if (arg == "--columns") {
+      columnNames = split(value);
+    } else if (arg == "--scalar") {
+      size_t pos = value.find('=');
+      if (pos == std::string::npos) {
+        printUsage(argv[0]);
+        return 1;
+      }
+      tensorflow::Tensor scalar(tensorflow::DT_FLOAT, {});
+      scalar.scalar<float>()() = std::stof(value.substr(pos + 1));
+      scalars.emplace_back(value.substr(0, pos), scalar);
+    } else if (arg == "--batch") {
+      batchSize = std::max(1, std::stoi(value));
+    } else if (arg == "--streams") {
+      nStreams = std::max(1, std::stoi(value));
+    } else if (arg == "--threads") {
+      nThreads = std::stoi(value);
+    } else if (arg == "--pool") {
+      threadPoolName = value;
+    } else if (arg == "--tag") {
+      tag = value;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (inputName.empty() || outputName.empty()) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  try {
+    tensorflow::setLogging();
+
+    // map the input and resolve feature columns
+    tensorflow::ColumnarFile input(inputPath);
+    if (featureNames.empty()) {
+      featureNames = input.columnNames();
+    }
+    std::vector<const float*> columns;
+    for (const std::string& featureName : featureNames) {
+      columns.push_back(input.column(input.columnIndex(featureName)));
+    }
+    size_t nRows = input.nRows();
+
+    // create the session from either a constant graph or a SavedModel
+    std::unique_ptr<tensorflow::GraphDef> graphDef;
+    std::unique_ptr<tensorflow::MetaGraphDef> metaGraphDef;
+    tensorflow::Session* session;
+    if (tensorflow::Env::Default()->IsDirectory(modelPath).ok()) {
+      metaGraphDef.reset(tensorflow::loadMetaGraphDef(modelPath, tag));
+      session = tensorflow::createSession(metaGraphDef.get(), modelPath, nThreads);
+    } else {
+      graphDef.reset(tensorflow::loadGraphDef(modelPath));
+      session = tensorflow::createSession(graphDef.get(), nThreads);
+    }
+
+    // evaluate a single row to warm up and to determine the number of output columns
+    tbb::enumerable_thread_specific<tensorflow::FeaturePacker> packers{tensorflow::FeaturePacker(featureNames)};
+    auto evaluate = [&](const Batch& batch, std::vector<tensorflow::Tensor>* outputs) {
+      std::vector<const float*> batchColumns(columns.size());
+      for (size_t f = 0; f < columns.size(); f++) {
+        batchColumns[f] = columns[f] + batch.start;
+      }
+      tensorflow::NamedTensorList inputs = scalars;
+      inputs.emplace_back(inputName, packers.local().packColumns(batchColumns, batch.end - batch.start));
+      tensorflow::run(session, inputs, {outputName}, outputs, threadPoolName);
+    };
+    size_t nOutputs = 1;
+    if (nRows > 0) {
+      std::vector<tensorflow::Tensor> outputs;
+      evaluate({0, 1}, &outputs);
+      if (outputs[0].dtype() != tensorflow::DT_FLOAT) {
+        throw cms::Exception("InvalidOutput") << "output '" << outputName << "' must be a float tensor";
+      }
+      if (outputs[0].dims() == 2) {
+        nOutputs = outputs[0].dim_size(1);
+      } else if (outputs[0].dims() != 1) {
+        throw cms::Exception("InvalidOutput") << "output '" << outputName << "' must have rank 1 or 2";
+      }
+    }
+    if (columnNames.empty()) {
+      for (size_t i = 0; i < nOutputs; i++) {
+        columnNames.push_back(outputName + "_" + std::to_string(i));
+      }
+    } else if (columnNames.size() != nOutputs) {
+      throw cms::Exception("InvalidOutput")
+          << "expected " << nOutputs << " output column names, got " << columnNames.size();
+    }
+
+    // create the output at its final size
+    tensorflow::ColumnarFileWriter output(outputPath, columnNames, nRows);
+    std::vector<float*> outputColumns;
+    for (size_t i = 0; i < nOutputs; i++) {
+      outputColumns.push_back(output.column(i));
+    }
+
+    // pipeline with a serial stage that hands out batches and asks the kernel to read ahead, a
+    // parallel stage that packs, evaluates and writes outputs, and a serial stage for progress
+    size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    size_t nextRow = 0;
+    size_t nDone = 0;
+    auto start = std::chrono::steady_clock::now();
+    tbb::task_arena arena(nStreams);
+    arena.execute([&] {
+      tbb::parallel_pipeline(
+          nStreams,
+          tbb::make_filter<void, Batch>(tbb::filter::serial_in_order,
+                                        [&](tbb::flow_control& fc) -> Batch {
+                                          if (nextRow >= nRows) {
+                                            fc.stop();
+                                            return {0, 0};
+                                          }
+                                          Batch batch{nextRow, std::min(nextRow + batchSize, nRows)};
+                                          nextRow = batch.end;
+                                          for (const float* column : columns) {
+                                            uintptr_t begin = uintptr_t(column + batch.start) / pageSize * pageSize;
+                                            uintptr_t end = uintptr_t(column + batch.end);
+                                            ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+                                          }
+                                          return batch;
+                                        }) &
+              tbb::make_filter<Batch, size_t>(tbb::filter::parallel,
+                                              [&](const Batch& batch) -> size_t {
+                                                std::vector<tensorflow::Tensor> outputs;
+                                                evaluate(batch, &outputs);
+                                                // the shape of the output is only known after the run,
+                                                // so check it per batch before writing
+                                                size_t n = batch.end - batch.start;
+                                                if (outputs[0].dtype() != tensorflow::DT_FLOAT ||
+                                                    outputs[0].NumElements() != tensorflow::int64(n * nOutputs)) {
+                                                  throw cms::Exception("InvalidOutput")
+                                                      << "output '" << outputName << "' of rows " << batch.start
+                                                      << " to " << batch.end << " has "
+                                                      << outputs[0].NumElements() << " elements, expected "
+                                                      << n * nOutputs << " float elements";
+                                                }
+                                                const float* values = outputs[0].flat<float>().data();
+                                                for (size_t i = 0; i < n; i++) {
+                                                  for (size_t j = 0; j < nOutputs; j++) {
+                                                    outputColumns[j][batch.start + i] = values[i * nOutputs + j];
+                                                  }
+                                                }
+                                                return n;
+                                              }) &
+              tbb::make_filter<size_t, void>(tbb::filter::serial_out_of_order, [&](size_t n) { nDone += n; }));
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    output.close();
+    tensorflow::closeSession(session);
+
+    std::cout << "evaluated " << nDone << " rows in " << seconds << " s ("
+              << (seconds > 0. ? nDone / seconds : 0.) << " rows/s)" << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
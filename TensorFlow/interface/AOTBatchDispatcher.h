@@ -0,0 +1,186 @@
+/*
+ * Runtime dispatcher for AOT-compiled (tfcompile) functions that were compiled for several batch
+ * sizes. For a given number of rows, the smallest specialization that fits is chosen, inputs are
+ * padded when necessary, and rows exceeding the largest batch size are split into chunks.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_AOTBATCHDISPATCHER_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_AOTBATCHDISPATCHER_H
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// included first as it requires EIGEN_USE_THREADS
+#include "PhysicsTools/TensorFlow/interface/TBBThreadPoolDevice.h"
+
+#include "tensorflow/compiler/tf2xla/xla_compiled_cpu_function.h"
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+namespace tensorflow {
+
+  // dispatches batches of rows to AOT functions that only differ in their batch size
+  // all arguments and results must have the batch dimension first and share the element type T
+  // not thread-safe as each specialization owns its argument and result buffers, so use one
+  // dispatcher per stream
+  // usage with classes MyModel_b1, MyModel_b16 generated from create_aot_batch_configs():
+  //   tensorflow::AOTBatchDispatcher<float> dispatcher({10}, {1});
+  //   dispatcher.addVariant<MyModel_b1>(1);
+  //   dispatcher.addVariant<MyModel_b16>(16);
+  //   dispatcher.run({inputData}, {outputData}, nRows);
+  // note that the build only supports a single DNN_NAME per target, so the classes per batch size
+  // must be generated by separate tfcompile rules
+  template <typename T>
+  class AOTBatchDispatcher {
+  public:
+    // argRowSizes and resultRowSizes define the number of elements per row of each argument and
+    // result, i.e., the product of all but the first dimension
+    AOTBatchDispatcher(const std::vector<size_t>& argRowSizes, const std::vector<size_t>& resultRowSizes)
+        : argRowSizes_(argRowSizes), resultRowSizes_(resultRowSizes), device_(nullptr) {}
+
+    AOTBatchDispatcher(const AOTBatchDispatcher&) = delete;
+    AOTBatchDispatcher& operator=(const AOTBatchDispatcher&) = delete;
+
+    // adds a specialization of the AOT function compiled for batchSize
+    // throws a cms exception when the sizes of its arguments and results do not match batchSize
+    template <typename AOTFunction>
+    void addVariant(size_t batchSize) {
+      if (batchSize == 0) {
+        throw cms::Exception("InvalidAOTVariant") << "batch size of AOT variant must be positive";
+      }
+      for (const auto& variant : variants_) {
+        if (variant.batchSize == batchSize) {
+          throw cms::Exception("InvalidAOTVariant") << "AOT variant with batch size " << batchSize << " already added";
+        }
+      }
+
+      std::unique_ptr<XlaCompiledCpuFunction> function(new AOTFunction());
+      if (size_t(function->num_args()) < argRowSizes_.size() ||
+          size_t(function->num_results()) < resultRowSizes_.size()) {
+        throw cms::Exception("InvalidAOTVariant")
+            << "AOT variant with batch size " << batchSize << " has " << function->num_args() << " arguments and "
+            << function->num_results() << " results, but " << argRowSizes_.size() << " and "
+            << resultRowSizes_.size() << " are expected";
+      }
+      // buffers must hold batchSize rows, as rows are copied without further checks in run()
+      for (size_t i = 0; i < argRowSizes_.size(); i++) {
+        if (size_t(function->arg_size(i)) != batchSize * argRowSizes_[i] * sizeof(T)) {
+          throw cms::Exception("InvalidAOTVariant")
+              << "argument " << i << " of AOT variant with batch size " << batchSize << " has "
+              << function->arg_size(i) << " bytes, but " << batchSize * argRowSizes_[i] * sizeof(T) << " are expected";
+        }
+      }
+      for (size_t i = 0; i < resultRowSizes_.size(); i++) {
+        if (size_t(function->result_size(i)) != batchSize * resultRowSizes_[i] * sizeof(T)) {
+          throw cms::Exception("InvalidAOTVariant")
+              << "result " << i << " of AOT variant with batch size " << batchSize << " has "
+              << function->result_size(i) << " bytes, but " << batchSize * resultRowSizes_[i] * sizeof(T)
+              << " are expected";
+        }
+      }
+
+      if (device_ != nullptr) {
+        function->set_thread_pool(device_);
+      }
+
+      variants_.push_back({batchSize, std::move(function)});
+
+      // keep variants sorted by batch size for the lookup in run()
+      std::sort(variants_.begin(), variants_.end(), [](const Variant& a, const Variant& b) {
+        return a.batchSize < b.batchSize;
+      });
+    }
+
+    // attaches a thread pool device to all current and future variants, the device must outlive
+    // the dispatcher
+    void setThreadPool(const TBBThreadPoolDevice& device) {
+      device_ = device.device();
+      for (auto& variant : variants_) {
+        variant.function->set_thread_pool(device_);
+      }
+    }
+
+    // returns the sorted batch sizes of all variants
+    std::vector<size_t> batchSizes() const {
+      std::vector<size_t> sizes;
+      for (const auto& variant : variants_) {
+        sizes.push_back(variant.batchSize);
+      }
+      return sizes;
+    }
+
+    // evaluates nRows rows given by args, which are stored row-wise in contiguous memory, and
+    // writes them to the pre-allocated memory in results
+    // throws a cms exception when not successful
+    void run(const std::vector<const T*>& args, const std::vector<T*>& results, size_t nRows) {
+      if (variants_.empty()) {
+        throw cms::Exception("InvalidAOTRun") << "cannot run AOT dispatcher without variants";
+      }
+      if (args.size() != argRowSizes_.size() || results.size() != resultRowSizes_.size()) {
+        throw cms::Exception("InvalidAOTRun")
+            << "AOT dispatcher expects " << argRowSizes_.size() << " arguments and " << resultRowSizes_.size()
+            << " results, got " << args.size() << " and " << results.size();
+      }
+
+      size_t offset = 0;
+      while (offset < nRows) {
+        // use the smallest variant that covers all remaining rows, or the largest one otherwise
+        size_t remaining = nRows - offset;
+        Variant& variant = selectVariant(remaining);
+        size_t chunkSize = std::min(remaining, variant.batchSize);
+        XlaCompiledCpuFunction& function = *variant.function;
+
+        // copy arguments and zero the padded rows
+        for (size_t i = 0; i < args.size(); i++) {
+          T* argData = static_cast<T*>(function.arg_data(i));
+          size_t n = chunkSize * argRowSizes_[i];
+          std::memcpy(argData, args[i] + offset * argRowSizes_[i], n * sizeof(T));
+          std::fill(argData + n, argData + variant.batchSize * argRowSizes_[i], T(0));
+        }
+
+        if (!function.Run()) {
+          throw cms::Exception("InvalidAOTRun") << "error while running AOT variant with batch size "
+                                                << variant.batchSize << ": " << function.error_msg();
+        }
+
+        // copy results, omitting padded rows
+        for (size_t i = 0; i < results.size(); i++) {
+          const T* resultData = static_cast<const T*>(function.result_data(i));
+          std::memcpy(
+              results[i] + offset * resultRowSizes_[i], resultData, chunkSize * resultRowSizes_[i] * sizeof(T));
+        }
+
+        offset += chunkSize;
+      }
+    }
+
+  private:
+    struct Variant {
+      size_t batchSize;
+      std::unique_ptr<XlaCompiledCpuFunction> function;
+    };
+
+    Variant& selectVariant(size_t nRows) {
+      for (auto& variant : variants_) {
+        if (variant.batchSize >= nRows) {
+          return variant;
+        }
+      }
+      return variants_.back();
+    }
+
+    const std::vector<size_t> argRowSizes_;
+    const std::vector<size_t> resultRowSizes_;
+    const Eigen::ThreadPoolDevice* device_;
+    std::vector<Variant> variants_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_AOTBATCHDISPATCHER_H
@@ -0,0 +1,120 @@
+/*
+ * Batched evaluation of sessions for collections of objects, split into chunks of bounded size.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_BATCHEDRUNNER_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_BATCHEDRUNNER_H
+
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
+
+#include "PhysicsTools/TensorFlow/interface/FeaturePacker.h"
+
+namespace tensorflow {
+
+  // evaluates a session once per chunk of objects instead of once per object, where features are
+  // extracted per object into a batched input tensor and outputs are passed back per object
+  // chunks are bounded by a number of input bytes, defaulting to 256 kB to keep inputs and
+  // intermediate results in cache, and can optionally be evaluated in parallel
+  // packers are kept per thread, so a runner can be shared between streams
+  // usage with a collection of jets:
+  //   tensorflow::BatchedRunner runner(session, "input", {"pt", "eta"}, {"output"});
+  //   std::vector<float> scores(jets.size());
+  //   runner.run(
+  //       jets,
+  //       [](const Jet& jet, float* row) {
+  //         row[0] = jet.pt();
+  //         row[1] = jet.eta();
+  //       },
+  //       [&](size_t i, const std::vector<tensorflow::Tensor>& outputs, int64 position) {
+  //         scores[i] = outputs[0].matrix<float>()(position, 0);
+  //       });
+  class BatchedRunner {
+  public:
+    // creates a runner feeding inputName of session with batches of featureNames, along with
+    // extraInputs that are fed unchanged, and fetching outputNames
+    BatchedRunner(Session* session,
+                  const std::string& inputName,
+                  const std::vector<std::string>& featureNames,
+                  const std::vector<std::string>& outputNames,
+                  const NamedTensorList& extraInputs = {});
+
+    // sets the maximum number of input bytes per chunk, resulting in at least one object per chunk
+    void setMaxChunkBytes(size_t maxChunkBytes) { maxChunkBytes_ = maxChunkBytes; }
+
+    // sets whether chunks are evaluated in parallel using tbb
+    void setParallel(bool parallel) { parallel_ = parallel; }
+
+    size_t nFeatures() const { return nFeatures_; }
+
+    // returns the number of objects per chunk
+    size_t chunkSize() const;
+
+    // evaluates all objects of a random access collection, where fill(object, row) must write
+    // nFeatures values to row, and scatter(index, outputs, position) is called per object with its
+    // index in the collection, the outputs of its chunk and its position therein
+    // scatter is called concurrently for different chunks when running in parallel
+    // throws a cms exception when not successful
+    template <typename Collection, typename Fill, typename Scatter>
+    void run(const Collection& objects,
+             Fill&& fill,
+             Scatter&& scatter,
+             const std::string& threadPoolName = "no_threads") const {
+      auto begin = std::begin(objects);
+      size_t n = std::distance(begin, std::end(objects));
+      size_t chunk = chunkSize();
+      size_t nChunks = (n + chunk - 1) / chunk;
+
+      auto runChunk = [&](size_t c) {
+        size_t start = c * chunk;
+        size_t end = std::min(start + chunk, n);
+        NamedTensorList inputs = extraInputs_;
+        inputs.emplace_back(inputName_,
+                            packers_.local().packObjects(Range<decltype(begin)>{begin + start, begin + end}, fill));
+        std::vector<Tensor> outputs;
+        tensorflow::run(session_, inputs, outputNames_, &outputs, threadPoolName);
+        for (size_t i = start; i < end; i++) {
+          scatter(i, outputs, int64(i - start));
+        }
+      };
+
+      if (parallel_ && nChunks > 1) {
+        // the packer of a thread is only safe to use as long as no other task of this runner
+        // interleaves on the same thread, which could happen while a thread waits for the session,
+        // e.g. with the tbb thread pool, so each chunk is isolated from tasks spawned outside of it
+        tbb::parallel_for(size_t(0), nChunks, [&](size_t c) { tbb::this_task_arena::isolate([&] { runChunk(c); }); });
+      } else {
+        for (size_t c = 0; c < nChunks; c++) {
+          runChunk(c);
+        }
+      }
+    }
+
+  private:
+    template <typename Iterator>
+    struct Range {
+      Iterator first;
+      Iterator last;
+
+      Iterator begin() const { return first; }
+      Iterator end() const { return last; }
+    };
+
+    Session* session_;
+    const std::string inputName_;
+    const std::vector<std::string> outputNames_;
+    const NamedTensorList extraInputs_;
+    const size_t nFeatures_;
+    size_t maxChunkBytes_;
+    bool parallel_;
+    mutable tbb::enumerable_thread_specific<FeaturePacker> packers_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_BATCHEDRUNNER_H
@@ -0,0 +1,95 @@
+/*
+ * Cascaded evaluation of a chain of sessions, where each stage only evaluates the rows accepted by
+ * the previous one.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_CASCADE_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_CASCADE_H
+
+#include <functional>
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace tensorflow {
+
+  // chain of stages that are evaluated on a batch of rows, where rows rejected by the predicate of
+  // a stage are removed before the next one
+  // surviving rows are compacted in place in an internal copy of the input that is reused as long
+  // as its capacity suffices, so the cascade is not thread-safe and should be used once per stream
+  // outputs that alias this copy, e.g. identities of the input, are copied so that results stay valid
+  // usage with a cheap preselection and a heavy classifier:
+  //   tensorflow::Cascade cascade;
+  //   cascade.addStage(preSession, "input", {"output"}, tensorflow::Cascade::threshold(0.1));
+  //   cascade.addStage(mainSession, "input", {"output"});
+  //   tensorflow::Cascade::Result result;
+  //   cascade.run(input, &result);
+  //   std::vector<float> scores = result.scatter(1);
+  class Cascade {
+  public:
+    // decides whether the row at position of the outputs of a stage is passed to the next stage
+    typedef std::function<bool(const std::vector<Tensor>& outputs, int64 position)> Predicate;
+
+    struct Result {
+      int64 nRows;
+      // indices of input rows evaluated per stage
+      std::vector<std::vector<int64>> rows;
+      // outputs per stage, whose first dimension corresponds to rows of that stage
+      std::vector<std::vector<Tensor>> outputs;
+
+      size_t nStages() const { return rows.size(); }
+
+      // returns the position of an input row in the outputs of a stage, or -1 when not evaluated
+      int64 position(size_t stage, int64 row) const;
+
+      // returns the index of the last stage that evaluated an input row
+      int lastStage(int64 row) const;
+
+      // returns a float value of an output of a stage per input row, using the element at column
+      // of each output row, and defaultValue for rows not evaluated by the stage
+      std::vector<float> scatter(size_t stage, size_t outputIndex = 0, int64 column = 0, float defaultValue = -1.)
+          const;
+    };
+
+    Cascade() {}
+
+    // adds a stage that feeds rows to inputName of session, along with extraInputs that are fed
+    // unchanged, and fetches outputNames, the predicate is not used for the last stage
+    void addStage(Session* session,
+                  const std::string& inputName,
+                  const std::vector<std::string>& outputNames,
+                  Predicate accept = nullptr,
+                  const NamedTensorList& extraInputs = {});
+
+    size_t nStages() const { return stages_.size(); }
+
+    // returns a predicate accepting rows whose value at column of an output is at least minValue
+    // the predicate throws a cms exception when the output is not a float tensor of rank 2 with more
+    // than column columns
+    static Predicate threshold(float minValue, size_t outputIndex = 0, int64 column = 0);
+
+    // evaluates all stages starting with all rows of input, whose first dimension is the batch
+    // dimension, and stores the rows and outputs per stage in result, stopping early when all
+    // rows are rejected
+    // throws a cms exception when not successful
+    void run(const Tensor& input, Result* result, const std::string& threadPoolName = "no_threads");
+
+  private:
+    struct Stage {
+      Session* session;
+      std::string inputName;
+      std::vector<std::string> outputNames;
+      Predicate accept;
+      NamedTensorList extraInputs;
+    };
+
+    std::vector<Stage> stages_;
+    Tensor buffer_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_CASCADE_H
@@ -0,0 +1,97 @@
+/*
+ * Memory-mapped files storing float32 features in columns, used for offline evaluation of large
+ * numbers of objects outside the framework.
+ * Layout: the 8 byte magic "TFCOL1\0\0", the number of rows and of columns as uint64, per column
+ * the name length as uint64 followed by the name, zero padding up to a multiple of 64 bytes, and
+ * finally one block of nRows floats per column, each padded to a multiple of 64 bytes.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_COLUMNARFILE_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_COLUMNARFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tensorflow {
+
+  // read-only view of a columnar file
+  class ColumnarFile {
+  public:
+    // maps the file at path
+    // throws a cms exception when the file cannot be mapped or is not a valid columnar file
+    explicit ColumnarFile(const std::string& path);
+
+    ~ColumnarFile();
+
+    ColumnarFile(const ColumnarFile&) = delete;
+    ColumnarFile& operator=(const ColumnarFile&) = delete;
+
+    size_t nRows() const { return nRows_; }
+
+    size_t nColumns() const { return columnNames_.size(); }
+
+    const std::vector<std::string>& columnNames() const { return columnNames_; }
+
+    // returns the index of a column, throws a cms exception when not existing
+    size_t columnIndex(const std::string& columnName) const;
+
+    // returns the values of a column, aligned to 64 bytes
+    const float* column(size_t index) const { return columns_.at(index); }
+
+    // returns the bytes between the first values of consecutive columns for nRows
+    static size_t columnStride(size_t nRows);
+
+    // returns the bytes of the header for columnNames, i.e., the offset of the first column
+    static size_t headerSize(const std::vector<std::string>& columnNames);
+
+  private:
+    std::string path_;
+    void* data_;
+    size_t size_;
+    size_t nRows_;
+    std::vector<std::string> columnNames_;
+    std::vector<const float*> columns_;
+  };
+
+  // creates a columnar file of fixed size and maps it for writing, so that values can be written
+  // to the columns directly
+  class ColumnarFileWriter {
+  public:
+    // creates the file at path for nRows and columnNames
+    // throws a cms exception when the file cannot be created or mapped
+    ColumnarFileWriter(const std::string& path, const std::vector<std::string>& columnNames, size_t nRows);
+
+    // closes the file when not closed yet
+    ~ColumnarFileWriter();
+
+    ColumnarFileWriter(const ColumnarFileWriter&) = delete;
+    ColumnarFileWriter& operator=(const ColumnarFileWriter&) = delete;
+
+    size_t nRows() const { return nRows_; }
+
+    size_t nColumns() const { return columns_.size(); }
+
+    // returns the writable values of a column
+    float* column(size_t index) { return columns_.at(index); }
+
+    // flushes and unmaps the file
+    // throws a cms exception when not successful
+    void close();
+
+  private:
+    std::string path_;
+    void* data_;
+    size_t size_;
+    size_t nRows_;
+    std::vector<float*> columns_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_COLUMNARFILE_H
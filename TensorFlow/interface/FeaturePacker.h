@@ -0,0 +1,122 @@
+/*
+ * Helpers to pack features of physics objects into batched, padded or ragged input tensors.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_FEATUREPACKER_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_FEATUREPACKER_H
+
+#include <algorithm>
+#include <iterator>
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace tensorflow {
+
+  // packs a fixed list of float features, declared once by name, into input tensors
+  // returned tensors share memory with internal buffers that are reused as long as their capacity
+  // suffices and no previously returned tensor refers to them anymore, so returned tensors stay
+  // valid while new buffers are only allocated when earlier results are kept
+  // not thread-safe, so use one packer per stream
+  // usage with a collection of objects providing pt() and eta():
+  //   tensorflow::FeaturePacker packer({"pt", "eta"});
+  //   tensorflow::Tensor input = packer.packObjects(jets, [](const Jet& jet, float* row) {
+  //     row[0] = jet.pt();
+  //     row[1] = jet.eta();
+  //   });
+  class FeaturePacker {
+  public:
+    explicit FeaturePacker(const std::vector<std::string>& featureNames);
+
+    size_t nFeatures() const { return featureNames_.size(); }
+
+    const std::vector<std::string>& featureNames() const { return featureNames_; }
+
+    // returns the index of a feature, throws a cms exception when not existing
+    size_t featureIndex(const std::string& featureName) const;
+
+    // packs n objects stored as structure of arrays with one column per feature, in the order of
+    // the feature names, into a tensor of shape {n, nFeatures}
+    Tensor packColumns(const std::vector<const float*>& columns, size_t n);
+
+    // packs objects stored as array of structures into a tensor of shape {n, nFeatures}, where
+    // fill(object, row) must write nFeatures values to row
+    template <typename Collection, typename Fill>
+    Tensor packObjects(const Collection& objects, Fill&& fill) {
+      size_t n = std::distance(std::begin(objects), std::end(objects));
+      Tensor tensor = buffer(kBatch, DT_FLOAT, n, {});
+      float* data = tensor.flat<float>().data();
+      for (const auto& object : objects) {
+        fill(object, data);
+        data += nFeatures();
+      }
+      return tensor;
+    }
+
+    // packs sequences of variable length per object into a tensor of shape
+    // {n, maxLength, nFeatures}, where length(object) returns the sequence length and
+    // fill(object, j, row) must write nFeatures values of the j-th element to row
+    // sequences are truncated to maxLength and padded with padValue
+    template <typename Collection, typename Length, typename Fill>
+    Tensor packPadded(
+        const Collection& objects, size_t maxLength, Length&& length, Fill&& fill, float padValue = 0.) {
+      size_t n = std::distance(std::begin(objects), std::end(objects));
+      Tensor tensor = buffer(kBatch, DT_FLOAT, n, {int64(maxLength)});
+      float* data = tensor.flat<float>().data();
+      size_t rowSize = maxLength * nFeatures();
+      for (const auto& object : objects) {
+        size_t l = std::min(size_t(length(object)), maxLength);
+        for (size_t j = 0; j < l; j++) {
+          fill(object, j, data + j * nFeatures());
+        }
+        std::fill(data + l * nFeatures(), data + rowSize, padValue);
+        data += rowSize;
+      }
+      return tensor;
+    }
+
+    // packs sequences of variable length per object into a values tensor of shape
+    // {sum(lengths), nFeatures} and a row splits tensor of shape {n + 1} and type int64, following
+    // the tf.RaggedTensor convention, with length and fill as in packPadded
+    template <typename Collection, typename Length, typename Fill>
+    std::pair<Tensor, Tensor> packRagged(const Collection& objects, Length&& length, Fill&& fill) {
+      size_t n = std::distance(std::begin(objects), std::end(objects));
+      Tensor rowSplits = buffer(kRowSplits, DT_INT64, n + 1, {});
+      auto splits = rowSplits.flat<int64>();
+      splits(0) = 0;
+      size_t i = 0;
+      for (const auto& object : objects) {
+        splits(i + 1) = splits(i) + int64(length(object));
+        i++;
+      }
+
+      Tensor values = buffer(kBatch, DT_FLOAT, splits(n), {});
+      float* data = values.flat<float>().data();
+      i = 0;
+      for (const auto& object : objects) {
+        for (int64 j = 0; j < splits(i + 1) - splits(i); j++) {
+          fill(object, j, data);
+          data += nFeatures();
+        }
+        i++;
+      }
+      return {values, rowSplits};
+    }
+
+  private:
+    enum BufferSlot { kBatch = 0, kRowSplits = 1, kNSlots = 2 };
+
+    // returns a tensor of shape {n, innerDims..., nFeatures} (or {n} for row splits) backed by the
+    // buffer in slot, which is reallocated when its capacity is exceeded
+    Tensor buffer(BufferSlot slot, DataType dtype, size_t n, const std::vector<int64>& innerDims);
+
+    const std::vector<std::string> featureNames_;
+    std::vector<Tensor> buffers_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_FEATUREPACKER_H
@@ -0,0 +1,126 @@
+/*
+ * Bounded, concurrent LRU cache of inference results, keyed by a model id and a fingerprint of the
+ * input tensors and output names.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_INFERENCECACHE_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_INFERENCECACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace tensorflow {
+
+  // the cache is split into shards with separate locks to reduce contention between threads, and
+  // limits as well as the LRU order apply per shard
+  // cached outputs share their memory with the tensors returned by lookups and must not be modified
+  class InferenceCache {
+  public:
+    // 128 bit fingerprint of a model id, input names, types, shapes and values, and output names,
+    // and a fingerprint of the model id alone to account stats per model
+    struct Key {
+      uint64 low;
+      uint64 high;
+      uint64 model;
+
+      bool operator==(const Key& other) const {
+        return low == other.low && high == other.high && model == other.model;
+      }
+    };
+
+    struct Stats {
+      int64 hits;
+      int64 misses;
+      int64 evictions;
+      size_t entries;
+      size_t bytes;
+
+      double hitRate() const { return hits + misses > 0 ? double(hits) / (hits + misses) : 0.; }
+    };
+
+    // creates a cache holding at most maxEntries results, and at most maxBytes bytes of output
+    // tensors when positive
+    explicit InferenceCache(size_t maxEntries = 1024, size_t maxBytes = 0, size_t nShards = 16);
+
+    InferenceCache(const InferenceCache&) = delete;
+    InferenceCache& operator=(const InferenceCache&) = delete;
+
+    // computes the key of a run
+    static Key key(const std::string& modelId,
+                   const NamedTensorList& inputs,
+                   const std::vector<std::string>& outputNames);
+
+    // stores the outputs of a key in outputs and returns true when found, and false otherwise
+    bool lookup(const Key& key, std::vector<Tensor>* outputs);
+
+    // inserts the outputs of a key, evicting the least recently used entries when full
+    void insert(const Key& key, const std::vector<Tensor>& outputs);
+
+    // returns the hit, miss and eviction counts, and the current number of entries and bytes
+    Stats stats() const;
+
+    // returns the stats of entries of a single model id
+    Stats stats(const std::string& modelId) const;
+
+    // removes all entries and resets the stats
+    void clear();
+
+  private:
+    struct KeyHash {
+      size_t operator()(const Key& key) const { return key.low; }
+    };
+
+    struct Entry {
+      Key key;
+      std::vector<Tensor> outputs;
+      size_t bytes;
+    };
+
+    struct Counts {
+      int64 hits = 0;
+      int64 misses = 0;
+      int64 evictions = 0;
+    };
+
+    struct Shard {
+      std::mutex mutex;
+      std::list<Entry> entries;
+      std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+      size_t bytes = 0;
+      // counts per model fingerprint
+      std::unordered_map<uint64, Counts> counts;
+    };
+
+    Shard& shard(const Key& key) { return *shards_[key.high % shards_.size()]; }
+
+    const size_t maxEntriesPerShard_;
+    const size_t maxBytesPerShard_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<int64> hits_;
+    std::atomic<int64> misses_;
+    std::atomic<int64> evictions_;
+  };
+
+  // run the session with inputs and outputNames and store output tensors as in run(), but return
+  // results from the cache when inputs and outputNames were already evaluated for the same modelId,
+  // and insert results otherwise, the cache is not used when it is a nullptr
+  // throws a cms exception when not successful
+  void run(InferenceCache* cache,
+           const std::string& modelId,
+           Session* session,
+           const NamedTensorList& inputs,
+           const std::vector<std::string>& outputNames,
+           std::vector<Tensor>* outputs,
+           const std::string& threadPoolName = "no_threads");
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_INFERENCECACHE_H
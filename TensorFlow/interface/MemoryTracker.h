@@ -0,0 +1,130 @@
+/*
+ * Memory accounting for sessions created via the TensorFlow interface, with an optional
+ * process-wide budget.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_MEMORYTRACKER_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_MEMORYTRACKER_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "FWCore/Utilities/interface/thread_safety_macros.h"
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+
+  // estimates the number of bytes held by a node when it is a constant or variable, or 0 otherwise
+  int64 estimateWeightBytes(const NodeDef& node);
+
+  // estimates the number of bytes held by constants and variables of a graph
+  int64 estimateWeightBytes(const GraphDef& graphDef);
+
+  // keeps track of the memory held by sessions, which consists of the weights of their graph,
+  // estimated at creation time, and of the bytes reserved by runs in flight
+  // every n-th run per session is traced to measure its peak bytes using the step stats of the run
+  // metadata, and each run reserves the largest peak measured so far plus its input bytes until it
+  // ends, so that concurrent runs are accounted for
+  // when a budget is set, new sessions and runs throw a cms exception if their estimated memory
+  // would exceed it
+  // tracking is disabled by default and should be enabled before sessions are created:
+  //   tensorflow::MemoryTracker::instance().setEnabled(true);
+  //   tensorflow::MemoryTracker::instance().setBudget(2LL << 30);
+  class MemoryTracker {
+  public:
+    struct Stats {
+      std::string name;
+      int64 weightBytes;
+      int64 lastRunBytes;
+      int64 peakRunBytes;
+      int64 reservedBytes;
+      int64 nRuns;
+      int64 nTracedRuns;
+
+      int64 currentBytes() const { return weightBytes + reservedBytes; }
+      int64 peakBytes() const { return weightBytes + peakRunBytes; }
+    };
+
+    static MemoryTracker& instance() {
+      CMS_THREAD_SAFE static MemoryTracker tracker;
+      return tracker;
+    }
+
+    MemoryTracker() : enabled_(false), budget_(0), traceInterval_(100), sessionCounter_(0) {}
+
+    // enables tracking and the statistics of the TensorFlow cpu allocator
+    void setEnabled(bool enabled);
+
+    bool enabled() const { return enabled_; }
+
+    // sets the process-wide budget in bytes, 0 disables the budget
+    void setBudget(int64 bytes) { budget_ = bytes; }
+
+    int64 budget() const { return budget_; }
+
+    // sets the interval n so that every n-th run per session is traced to measure its memory, the
+    // first run of each session is always traced
+    void setTraceInterval(int64 interval) { traceInterval_ = interval > 0 ? interval : 1; }
+
+    int64 traceInterval() const { return traceInterval_; }
+
+    // registers a session with its weight bytes
+    // throws a cms exception when the budget would be exceeded
+    void registerSession(const Session* session, int64 weightBytes);
+
+    // removes a session, does nothing when the session is not registered
+    void unregisterSession(const Session* session);
+
+    // sets the name of a registered session, sessions with the same name are accumulated per model
+    void setSessionName(const Session* session, const std::string& name);
+
+    // called before a run with the number of input bytes, reserves the expected bytes of the run and
+    // returns whether the run should be traced, the reserved bytes are stored in reservedBytes
+    // throws a cms exception when the budget would be exceeded, in which case nothing is reserved
+    bool beginRun(const Session* session, int64 inputBytes, int64* reservedBytes);
+
+    // called after a successful run with its metadata if traced, or nullptr otherwise, and the bytes
+    // reserved by beginRun, which are released
+    void endRun(const Session* session, const RunMetadata* runMetadata, int64 outputBytes, int64 reservedBytes);
+
+    // called after a failed run to release the bytes reserved by beginRun
+    void cancelRun(const Session* session, int64 reservedBytes);
+
+    // returns the stats of a registered session
+    // throws a cms exception when the session is not registered
+    Stats sessionStats(const Session* session) const;
+
+    // returns the stats of all sessions, accumulated per session name
+    std::vector<Stats> modelStats() const;
+
+    // returns the sum of current bytes of all sessions, i.e., their weights and runs in flight
+    int64 totalBytes() const;
+
+    // returns the bytes in use by the TensorFlow cpu allocator, or -1 when not available
+    int64 allocatorBytesInUse() const;
+
+    // prints stats of all models to the message logger
+    void report() const;
+
+  private:
+    int64 totalBytesLocked() const;
+
+    std::atomic<bool> enabled_;
+    std::atomic<int64> budget_;
+    std::atomic<int64> traceInterval_;
+    int64 sessionCounter_;
+    mutable std::mutex mutex_;
+    std::map<const Session*, Stats> sessions_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_MEMORYTRACKER_H
@@ -0,0 +1,59 @@
+/*
+ * Static cost analysis of graphs, estimating floating point operations, parameter bytes and peak
+ * activation memory from shapes inferred for a given batch size.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_MODELCOST_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_MODELCOST_H
+
+#include <map>
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace tensorflow {
+
+  // estimated cost of a single node
+  struct OpCost {
+    std::string name;
+    std::string op;
+    int64 flops;
+    int64 paramBytes;
+    int64 outputBytes;
+  };
+
+  // estimated cost of a graph evaluated for batchSize elements
+  struct ModelCost {
+    int64 batchSize;
+    int64 flops;
+    int64 paramBytes;
+    int64 peakActivationBytes;
+    // whether all shapes relevant for the estimates could be inferred, unknown dimensions count as 1
+    bool complete;
+    // nodes in execution order
+    std::vector<OpCost> ops;
+
+    double flopsPerElement() const { return double(flops) / batchSize; }
+    double peakActivationBytesPerElement() const { return double(peakActivationBytes) / batchSize; }
+
+    // returns a printable summary including the nTop most expensive ops
+    std::string report(size_t nTop = 10) const;
+  };
+
+  // analyzes the cost of graphDef with shapes inferred after setting unknown dimensions of
+  // placeholders to batchSize, or to the shapes in inputShapes for placeholders listed there
+  // flops are counted for matrix multiplications, convolutions, pooling, reductions and
+  // element-wise ops, and peak activation memory follows from the lifetime of all non-parameter
+  // outputs when nodes are executed in topological order, which is an upper bound as buffers
+  // forwarded by ops like Identity or Reshape are counted as allocations
+  // throws a cms exception when the graph cannot be imported
+  ModelCost analyzeModelCost(const GraphDef& graphDef,
+                             int64 batchSize = 1,
+                             const std::map<std::string, TensorShape>& inputShapes = {});
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_MODELCOST_H
@@ -0,0 +1,111 @@
+/*
+ * Lightweight evaluator for small dense networks stored in constant graphs. Supported subgraphs
+ * (MatMul, BiasAdd, element-wise Add/Sub/Mul, Relu, Relu6, Elu, Sigmoid, Tanh, Softmax, ConcatV2
+ * and Identity) are compiled into a flat list of steps with fused bias and activation and are
+ * evaluated with Eigen kernels, without involving the TensorFlow runtime.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_NATIVEGRAPH_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_NATIVEGRAPH_H
+
+#include <map>
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace tensorflow {
+
+  class NativeGraph {
+  public:
+    // compiles the part of graphDef that is required to compute outputNames
+    // throws a cms exception when the graph contains unsupported ops or shapes
+    NativeGraph(const GraphDef& graphDef, const std::vector<std::string>& outputNames);
+
+    // returns whether all outputNames can be computed by this graph
+    bool hasOutputs(const std::vector<std::string>& outputNames) const;
+
+    // returns the number of compiled steps, i.e., kernel invocations per evaluation
+    size_t nSteps() const { return steps_.size(); }
+
+    // evaluates the graph with inputs and stores tensors of outputNames in outputs
+    // inputs of shape {batch, n} are expected for placeholders with known rank 2, while all other
+    // placeholders are fed with either a single value or n values of shape {n} or {1, n} that are
+    // broadcasted row-wise
+    // the method is const and can be called concurrently
+    // throws a cms exception when not successful
+    void run(const NamedTensorList& inputs,
+             const std::vector<std::string>& outputNames,
+             std::vector<Tensor>* outputs) const;
+
+  private:
+    enum class Activation { None, Relu, Relu6, Elu, Sigmoid, Tanh, Softmax };
+    enum class StepType { Dense, Binary, Activation, Concat };
+    enum class OperandKind { Batch, Constant, Broadcast };
+
+    // reference to a batch buffer, a constant row vector, or a broadcasted input
+    struct Operand {
+      OperandKind kind;
+      int index;
+    };
+
+    struct Step {
+      StepType type;
+      int output;
+      std::vector<Operand> inputs;
+      int weights;
+      int bias;
+      char binaryOp;
+      bool reversed;
+      Activation activation;
+    };
+
+    typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> WeightMatrix;
+    typedef Eigen::Array<float, 1, Eigen::Dynamic> ConstantRow;
+
+    Operand compileTensor(const std::string& tensorName);
+    Operand compileNode(const NodeDef& node);
+    bool findConstant(const std::string& tensorName, Tensor* tensor) const;
+    std::string resolveAlias(const std::string& tensorName) const;
+    Operand addBuffer(int width, int batchInput = -1);
+    int addConstant(const Tensor& tensor, const std::string& nodeName);
+    int width(const Operand& operand) const;
+    bool fusable(const Operand& operand) const;
+
+    // state only used during compilation
+    std::map<std::string, const NodeDef*> nodes_;
+    std::map<std::string, int> nConsumers_;
+    std::map<std::string, Operand> compiled_;
+    std::vector<std::string> compiling_;
+
+    // compiled graph
+    std::vector<Step> steps_;
+    std::vector<WeightMatrix> weights_;
+    std::vector<ConstantRow> constants_;
+    std::vector<int> bufferWidths_;
+    std::vector<int> bufferInputs_;
+    std::vector<std::string> batchInputs_;
+    std::vector<std::string> broadcastInputs_;
+    std::map<std::string, int> outputBuffers_;
+  };
+
+  // returns a new native graph for outputNames, or a nullptr when graphDef contains unsupported
+  // ops in which case the reason is logged
+  // transfers ownership
+  NativeGraph* createNativeGraph(const GraphDef* graphDef, const std::vector<std::string>& outputNames);
+
+  // evaluates nativeGraph when it is valid and provides all outputNames, and falls back to running
+  // the session using a threadPoolName ("no_threads", "tbb", or "tensorflow") otherwise
+  // throws a cms exception when not successful
+  void run(const NativeGraph* nativeGraph,
+           Session* session,
+           const NamedTensorList& inputs,
+           const std::vector<std::string>& outputNames,
+           std::vector<Tensor>* outputs,
+           const std::string& threadPoolName = "no_threads");
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_NATIVEGRAPH_H
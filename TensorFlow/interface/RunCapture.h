@@ -0,0 +1,111 @@
+/*
+ * Capturing of inputs, output names and timings of session runs to a compact binary file, and
+ * reading them back for offline replay.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_RUNCAPTURE_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_RUNCAPTURE_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "FWCore/Utilities/interface/thread_safety_macros.h"
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+
+  // a single captured run
+  struct CapturedRun {
+    std::string sessionName;
+    std::vector<std::pair<std::string, Tensor>> inputs;
+    std::vector<std::string> outputNames;
+    int64 durationNs;
+  };
+
+  // writes sampled runs to a zlib-compressed TFRecord file, where each record contains the name of
+  // the session, the inputs, the output names and the duration of the run
+  // runs performed via tensorflow::run() are captured while active:
+  //   tensorflow::RunCapture::instance().start("runs.tfrecord", 10);
+  //   ...
+  //   tensorflow::RunCapture::instance().stop();
+  class RunCapture {
+  public:
+    static RunCapture& instance() {
+      CMS_THREAD_SAFE static RunCapture capture;
+      return capture;
+    }
+
+    RunCapture() : active_(false), sampleInterval_(1), nCalls_(0), nRecorded_(0), session_(nullptr) {}
+
+    // stops an active capture, logging errors instead of throwing
+    ~RunCapture();
+
+    // starts capturing every sampleInterval-th run to path, restricted to session when not a nullptr
+    // throws a cms exception when the file cannot be opened or a capture is already active
+    void start(const std::string& path, int64 sampleInterval = 1, const Session* session = nullptr);
+
+    // stops capturing and closes the file, does nothing when not active
+    void stop();
+
+    bool active() const { return active_; }
+
+    // sets the name of a session that is stored in records, defaults to "session_<n>"
+    void setSessionName(const Session* session, const std::string& name);
+
+    // returns whether the next run of session should be captured
+    bool sample(const Session* session);
+
+    // writes a record of a run
+    // when the record cannot be written, a warning is logged and the capture is stopped
+    void record(const Session* session,
+                const std::vector<std::pair<std::string, Tensor>>& inputs,
+                const std::vector<std::string>& outputNames,
+                int64 durationNs);
+
+    // returns the number of records written since the last start
+    int64 nRecorded() const { return nRecorded_; }
+
+  private:
+    std::atomic<bool> active_;
+    std::atomic<int64> sampleInterval_;
+    std::atomic<int64> nCalls_;
+    std::atomic<int64> nRecorded_;
+    std::atomic<const Session*> session_;
+    std::mutex mutex_;
+    std::map<const Session*, std::string> sessionNames_;
+    std::unique_ptr<WritableFile> file_;
+    std::unique_ptr<io::RecordWriter> writer_;
+  };
+
+  // sequentially reads runs from a file written by RunCapture
+  class RunCaptureReader {
+  public:
+    // opens the file at path
+    // throws a cms exception when the file cannot be opened
+    explicit RunCaptureReader(const std::string& path);
+
+    // reads the next run into capturedRun and returns true, or returns false at the end of the file
+    // or when a record cannot be parsed, in which case a warning is logged
+    // throws a cms exception when the file cannot be read
+    bool next(CapturedRun* capturedRun);
+
+  private:
+    std::string path_;
+    std::unique_ptr<RandomAccessFile> file_;
+    std::unique_ptr<io::SequentialRecordReader> reader_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_RUNCAPTURE_H
@@ -0,0 +1,111 @@
+/*
+ * NUMA-aware session replicas. One session is created per NUMA node from a thread pinned to that
+ * node, so that weights and TensorFlow's own per-session thread pools are local to it, and runs are
+ * routed to the replica of the node the calling thread is running on.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_SESSIONREPLICAS_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_SESSIONREPLICAS_H
+
+#include <memory>
+
+#include "tbb/task_arena.h"
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+namespace tensorflow {
+
+  // returns the ids of cpus per NUMA node that the process is allowed to run on, as read from
+  // /sys/devices/system/node, or a single node with all allowed cpus when the topology is unknown
+  std::vector<std::vector<int>> numaNodeCPUs();
+
+  // thread pool that schedules tasks in a persistent TBB task arena whose threads are pinned to a
+  // set of cpus while they work in the arena, nThreads defaults to the number of cpus
+  class PinnedTBBThreadPool : public thread::ThreadPoolInterface {
+  public:
+    explicit PinnedTBBThreadPool(const std::vector<int>& cpus, int nThreads = -1);
+    ~PinnedTBBThreadPool() override;
+
+    void Schedule(std::function<void()> fn) override;
+
+    void ScheduleWithHint(std::function<void()> fn, int start, int end) override { Schedule(fn); }
+
+    void Cancel() override {}
+
+    int NumThreads() const override { return nThreads_; }
+
+    int CurrentThreadId() const override;
+
+    int GetNumScheduleCalled() { return numScheduleCalled_; }
+
+  private:
+    class Pinner;
+
+    const int nThreads_;
+    tbb::task_arena taskArena_;
+    std::unique_ptr<Pinner> pinner_;
+    std::atomic<int> numScheduleCalled_;
+  };
+
+  // set of sessions holding the same graph, with one replica per NUMA node
+  // degrades to a single, unpinned replica on single-node machines or when numaAware is false
+  // constants of graphDefs are materialized during the first run, which happens on the node of the
+  // calling thread as runs are routed to the local replica
+  class SessionReplicas {
+  public:
+    // creates replicas of a session containing graphDef, using nThreads per replica
+    SessionReplicas(GraphDef* graphDef, int nThreads = 1, bool numaAware = true);
+
+    // creates replicas of a session containing metaGraphDef whose variables are restored from
+    // exportDir, using nThreads per replica
+    SessionReplicas(MetaGraphDef* metaGraphDef, const std::string& exportDir, int nThreads = 1, bool numaAware = true);
+
+    // closes all sessions
+    ~SessionReplicas();
+
+    SessionReplicas(const SessionReplicas&) = delete;
+    SessionReplicas& operator=(const SessionReplicas&) = delete;
+
+    size_t size() const { return replicas_.size(); }
+
+    // returns the index of the replica local to the calling thread
+    size_t localReplica() const;
+
+    // returns the session of the replica local to the calling thread
+    Session* session() const { return replicas_[localReplica()].session; }
+
+    // returns the session of a replica
+    Session* session(size_t replica) const { return replicas_.at(replica).session; }
+
+    // returns the cpus of a replica, which is empty when the replica is not pinned
+    const std::vector<int>& cpus(size_t replica) const { return replicas_.at(replica).cpus; }
+
+    // runs the replica local to the calling thread with inputs and outputNames, stores output
+    // tensors, and controls the underlying thread pool using a threadPoolName ("no_threads", "tbb",
+    // or "tensorflow"), where "tbb" refers to a thread pool pinned to the replica's node
+    // throws a cms exception when not successful
+    void run(const NamedTensorList& inputs,
+             const std::vector<std::string>& outputNames,
+             std::vector<Tensor>* outputs,
+             const std::string& threadPoolName = "no_threads") const;
+
+  private:
+    struct Replica {
+      std::vector<int> cpus;
+      Session* session;
+      std::unique_ptr<PinnedTBBThreadPool> threadPool;
+    };
+
+    void createReplicas(const std::function<Session*()>& create, bool numaAware);
+
+    std::vector<Replica> replicas_;
+    std::vector<int> cpuReplicas_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_SESSIONREPLICAS_H
@@ -0,0 +1,135 @@
+/*
+ * Eigen thread pool device backed by TBB, to be attached to AOT-compiled (tfcompile) functions via
+ * their set_thread_pool() method. Each instance owns a task arena so that the number of threads
+ * used by a single AOT function can be limited.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#ifndef PHYSICSTOOLS_TENSORFLOW_INTERFACE_TBBTHREADPOOLDEVICE_H
+#define PHYSICSTOOLS_TENSORFLOW_INTERFACE_TBBTHREADPOOLDEVICE_H
+
+// the Eigen thread pool device is only declared when EIGEN_USE_THREADS is defined before the Eigen
+// tensor module is included for the first time, so this header must be included before any
+// Eigen or TensorFlow header unless EIGEN_USE_THREADS is defined globally
+#if defined(EIGEN_CXX11_TENSOR_MODULE) && !defined(EIGEN_USE_THREADS)
+#error "TBBThreadPoolDevice.h requires EIGEN_USE_THREADS, include it before any Eigen or TensorFlow header"
+#endif
+
+#ifndef EIGEN_USE_THREADS
+#define EIGEN_USE_THREADS
+#endif
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+#include "tbb/task_scheduler_init.h"
+#include "tbb/task_arena.h"
+#include "tbb/task_group.h"
+
+namespace tensorflow {
+
+  // Eigen thread pool interface that runs tasks in a dedicated TBB task arena
+  // tasks scheduled from within the pool are enqueued without blocking, as Eigen synchronizes them
+  // itself using barriers, while tasks scheduled by other threads are run synchronously with the
+  // calling thread taking part in the work via the reserved slot of the arena, so that progress
+  // never depends on TBB workers being available, as in the TBBThreadPool
+  class TBBEigenThreadPool : public Eigen::ThreadPoolInterface {
+  public:
+    explicit TBBEigenThreadPool(int nThreads = -1)
+        : nThreads_(nThreads > 0 ? nThreads : tbb::task_scheduler_init::default_num_threads()),
+          // reserve a slot for the calling thread which joins the work while waiting
+          taskArena_(nThreads_, 1),
+          numScheduleCalled_(0) {}
+
+    ~TBBEigenThreadPool() override {
+      // we are required to always call wait before destructor
+      taskArena_.execute([this]() { taskGroup_.wait(); });
+    }
+
+    void Schedule(std::function<void()> fn) override {
+      numScheduleCalled_ += 1;
+
+      // mark the executing thread as part of this pool while running the task
+      auto task = [this, fn = std::move(fn)]() {
+        const TBBEigenThreadPool* previous = currentPool();
+        currentPool() = this;
+        fn();
+        currentPool() = previous;
+      };
+
+      if (currentPool() == this) {
+        taskArena_.execute([this, &task]() { taskGroup_.run(std::move(task)); });
+      } else {
+        taskArena_.execute([this, &task]() {
+          taskGroup_.run(std::move(task));
+          taskGroup_.wait();
+        });
+      }
+    }
+
+    void ScheduleWithHint(std::function<void()> fn, int start, int end) override { Schedule(std::move(fn)); }
+
+    void Cancel() override {}
+
+    int NumThreads() const override { return nThreads_; }
+
+    // Eigen expects ids in the range [0, NumThreads()) for threads of the pool and -1 otherwise,
+    // so the slot index is only used for threads that run a task of this pool, as threads in other
+    // arenas have slot indices in the same range
+    int CurrentThreadId() const override {
+      if (currentPool() != this) {
+        return -1;
+      }
+      int id = tbb::this_task_arena::current_thread_index();
+      return (id >= 0 && id < nThreads_) ? id : -1;
+    }
+
+    int GetNumScheduleCalled() { return numScheduleCalled_; }
+
+  private:
+    // pool whose task is being run by the current thread, or a nullptr
+    static const TBBEigenThreadPool*& currentPool() {
+      thread_local const TBBEigenThreadPool* pool = nullptr;
+      return pool;
+    }
+
+    const int nThreads_;
+    tbb::task_arena taskArena_;
+    tbb::task_group taskGroup_;
+    std::atomic<int> numScheduleCalled_;
+  };
+
+  // Eigen thread pool device using a TBBEigenThreadPool with a per-instance thread limit
+  // usage with a tfcompile'd class MyModel:
+  //   tensorflow::TBBThreadPoolDevice device(4);
+  //   MyModel model;
+  //   device.attach(model);
+  class TBBThreadPoolDevice {
+  public:
+    explicit TBBThreadPoolDevice(int nThreads = -1) : pool_(nThreads), device_(&pool_, pool_.NumThreads()) {}
+
+    TBBThreadPoolDevice(const TBBThreadPoolDevice&) = delete;
+    TBBThreadPoolDevice& operator=(const TBBThreadPoolDevice&) = delete;
+
+    // attaches the device to an AOT-compiled function, the device must outlive the function
+    template <typename AOTFunction>
+    void attach(AOTFunction& aotFunction) const {
+      aotFunction.set_thread_pool(&device_);
+    }
+
+    const Eigen::ThreadPoolDevice* device() const { return &device_; }
+
+    TBBEigenThreadPool& pool() { return pool_; }
+
+    int NumThreads() const { return pool_.NumThreads(); }
+
+  private:
+    TBBEigenThreadPool pool_;
+    Eigen::ThreadPoolDevice device_;
+  };
+
+}  // namespace tensorflow
+
+#endif  // PHYSICSTOOLS_TENSORFLOW_INTERFACE_TBBTHREADPOOLDEVICE_H
@@ -16,10 +16,13 @@
 #include "tensorflow/core/util/tensor_bundle/naming.h"
 #include "tensorflow/cc/client/client_session.h"
 #include "tensorflow/cc/saved_model/loader.h"
+#include "tensorflow/cc/saved_model/reader.h"
 #include "tensorflow/cc/saved_model/constants.h"
 #include "tensorflow/cc/saved_model/tag_constants.h"
 
+#include "PhysicsTools/TensorFlow/interface/MemoryTracker.h"
 #include "PhysicsTools/TensorFlow/interface/NoThreadPool.h"
+#include "PhysicsTools/TensorFlow/interface/RunCapture.h"
 #include "PhysicsTools/TensorFlow/interface/TBBThreadPool.h"
 
 #include "FWCore/Utilities/interface/Exception.h"
@@ -40,16 +43,17 @@ namespace tensorflow {
   // since the threading configuration is done per run() call as of 2.1
   void setThreading(SessionOptions& sessionOptions, int nThreads, const std::string& singleThreadPool);
 
-  // loads a meta graph definition saved at exportDir using the SavedModel interface for a tag and
-  // predefined sessionOptions
+  // loads a meta graph definition saved at exportDir using the SavedModel interface for a tag
+  // only the saved_model.pb file is read while variables are restored by createSession, so
+  // sessionOptions are not used and only kept for compatibility
   // transfers ownership
   MetaGraphDef* loadMetaGraphDef(const std::string& exportDir, const std::string& tag, SessionOptions& sessionOptions);
 
   // deprecated in favor of loadMetaGraphDef
   MetaGraphDef* loadMetaGraph(const std::string& exportDir, const std::string& tag, SessionOptions& sessionOptions);
 
-  // loads a meta graph definition saved at exportDir using the SavedModel interface for a tag and
-  // nThreads
+  // loads a meta graph definition saved at exportDir using the SavedModel interface for a tag
+  // only the saved_model.pb file is read, so nThreads is not used and only kept for compatibility
   // transfers ownership
   MetaGraphDef* loadMetaGraphDef(const std::string& exportDir,
                                  const std::string& tag = kSavedModelTagServe,
@@ -60,10 +64,36 @@ namespace tensorflow {
                               const std::string& tag = kSavedModelTagServe,
                               int nThreads = 1);
 
-  // loads a graph definition saved as a protobuf file at pbFile
+  // loads a graph definition saved as a protobuf file at pbFile, which may be compressed with zstd
+  // or gzip in which case it is decompressed while parsing
   // transfers ownership
   GraphDef* loadGraphDef(const std::string& pbFile);
 
+  // loads a graph definition from a buffer containing a binary protobuf, e.g. embedded in a library,
+  // which may be compressed with zstd or gzip in which case it is decompressed while parsing
+  // transfers ownership
+  GraphDef* loadGraphDefFromBuffer(const void* data, size_t size);
+
+  // loads the meta graph definition for a tag from a buffer containing the content of the
+  // saved_model.pb file of a SavedModel, which may be compressed as in loadGraphDefFromBuffer
+  // variables are not part of the buffer, so the export directory must still be passed to
+  // createSession to restore them
+  // transfers ownership
+  MetaGraphDef* loadMetaGraphDefFromBuffer(const void* data,
+                                           size_t size,
+                                           const std::string& tag = kSavedModelTagServe);
+
+  // merges multiple graph definitions into a single one so that they can be evaluated with a single
+  // session run, graphDefs are given as pairs of namespace and graph, and all node names are prefixed
+  // with the namespace of their graph (e.g. "modelA/output"), except for placeholders listed in
+  // sharedInputs which keep their name and are fed only once to all graphs
+  // an error is thrown when a graphDef is a nullptr, a namespace is empty or not unique, or when a
+  // shared input is not a placeholder or has different types across graphs, or when functions of
+  // the same name have different definitions
+  // transfers ownership
+  GraphDef* mergeGraphDefs(const std::vector<std::pair<std::string, const GraphDef*>>& graphDefs,
+                           const std::vector<std::string>& sharedInputs = {});
+
   // return a new, empty session using predefined sessionOptions
   // transfers ownership
   Session* createSession(SessionOptions& sessionOptions);
@@ -75,6 +105,8 @@ namespace tensorflow {
   // return a new session that will contain an already loaded meta graph whose exportDir must be
   // given in order to load and initialize the variables, sessionOptions are predefined
   // an error is thrown when metaGraphDef is a nullptr or when the graph has no nodes
+  // when memory tracking is enabled, the session is registered at the MemoryTracker and an error is
+  // thrown when its weights exceed the memory budget
   // transfers ownership
   Session* createSession(MetaGraphDef* metaGraphDef, const std::string& exportDir, SessionOptions& sessionOptions);
 
@@ -84,8 +116,32 @@ namespace tensorflow {
   // transfers ownership
   Session* createSession(MetaGraphDef* metaGraphDef, const std::string& exportDir, int nThreads = 1);
 
+  // return a new session that will contain an already loaded meta graph whose exportDir must be
+  // given in order to load and initialize only the variables required to compute outputNames,
+  // sessionOptions are predefined
+  // variables are read from the checkpoint individually and assigned using the restore ops of the
+  // saver, falling back to restoring all variables when a required variable is not covered by them
+  // an error is thrown when metaGraphDef is a nullptr or when the graph has no nodes
+  // transfers ownership
+  Session* createSession(MetaGraphDef* metaGraphDef,
+                         const std::string& exportDir,
+                         const std::vector<std::string>& outputNames,
+                         SessionOptions& sessionOptions);
+
+  // return a new session that will contain an already loaded meta graph whose exportDir must be
+  // given in order to load and initialize only the variables required to compute outputNames,
+  // threading options are inferred from nThreads
+  // an error is thrown when metaGraphDef is a nullptr or when the graph has no nodes
+  // transfers ownership
+  Session* createSession(MetaGraphDef* metaGraphDef,
+                         const std::string& exportDir,
+                         const std::vector<std::string>& outputNames,
+                         int nThreads = 1);
+
   // return a new session that will contain an already loaded graph def, sessionOptions are predefined
   // an error is thrown when graphDef is a nullptr or when the grah has no nodes
+  // when memory tracking is enabled, the session is registered at the MemoryTracker and an error is
+  // thrown when its weights exceed the memory budget
   // transfers ownership
   Session* createSession(GraphDef* graphDef, SessionOptions& sessionOptions);
 
@@ -101,7 +157,8 @@ namespace tensorflow {
   // run the session with inputs and outputNames, store output tensors, and control the underlying
   // thread pool using threadPoolOptions
   // used for thread scheduling with custom thread pool options
-  // throws a cms exception when not successful
+  // when memory tracking is enabled, the run is accounted for by the MemoryTracker
+  // throws a cms exception when not successful or when the memory budget would be exceeded
   void run(Session* session,
            const NamedTensorList& inputs,
            const std::vector<std::string>& outputNames,
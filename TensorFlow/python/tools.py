@@ -5,7 +5,10 @@ TensorFlow tools and helpers.
 """
 
 
-__all__ = ["TF1", "TF2", "read_constant_graph", "write_constant_graph", "visualize_graph"]
+__all__ = [
+    "TF1", "TF2", "read_constant_graph", "write_constant_graph", "visualize_graph",
+    "create_aot_batch_configs", "write_columnar_file", "read_columnar_file", "analyze_model_cost",
+]
 
 
 import os
@@ -190,6 +193,329 @@ def visualize_graph(graph, log_dir=None, start_tensorboard=False, tensorboard_ar
         shutil.rmtree(log_dir)
 
 
+def create_aot_batch_configs(config_path, batch_sizes, output_dir=None, batched_feeds=None):
+    """
+    Reads a tfcompile config file (text form of the ``tensorflow.tf2xla.Config`` proto) at
+    *config_path* and creates one config per batch size in *batch_sizes* by setting the first
+    dimension of all feeds to that size. Feeds can be restricted to the names in *batched_feeds*,
+    for instance to exclude scalar inputs. Files are named ``<name>_b<batch_size>.config.pbtxt``
+    and written to *output_dir*, which defaults to the directory of *config_path*. A list of the
+    absolute paths of the created files is returned. Example:
+
+    .. code-block:: python
+
+        create_aot_batch_configs("model.config.pbtxt", [1, 4, 16, 64])
+        # -> ["model_b1.config.pbtxt", "model_b4.config.pbtxt", ...]
+
+    Each config is then compiled with tfcompile and the generated classes can be combined at
+    runtime using the ``tensorflow::AOTBatchDispatcher``.
+    """
+    from google.protobuf import text_format
+    from tensorflow.compiler.tf2xla import tf2xla_pb2
+
+    # read the template config
+    config_path = os.path.normpath(os.path.abspath(config_path))
+    with open(config_path, "r") as f:
+        config = text_format.Parse(f.read(), tf2xla_pb2.Config())
+
+    # prepare the output directory and the file name stem
+    if not output_dir:
+        output_dir = os.path.dirname(config_path)
+    output_dir = os.path.normpath(os.path.abspath(output_dir))
+    if not os.path.exists(output_dir):
+        os.makedirs(output_dir)
+    name = os.path.basename(config_path)
+    for ext in (".config.pbtxt", ".pbtxt"):
+        if name.endswith(ext):
+            name = name[:-len(ext)]
+            break
+
+    output_paths = []
+    for batch_size in sorted(set(int(b) for b in batch_sizes)):
+        if batch_size <= 0:
+            raise ValueError("batch sizes must be positive, got {}".format(batch_size))
+
+        batch_config = tf2xla_pb2.Config()
+        batch_config.CopyFrom(config)
+        for feed in batch_config.feed:
+            if batched_feeds is not None and feed.id.node_name not in batched_feeds:
+                continue
+            if not feed.shape.dim:
+                raise ValueError("feed '{}' has no dimensions to batch".format(feed.id.node_name))
+            feed.shape.dim[0].size = batch_size
+
+        output_path = os.path.join(output_dir, "{}_b{}.config.pbtxt".format(name, batch_size))
+        with open(output_path, "w") as f:
+            f.write("# Text form of tensorflow.tf2xla.Config proto.\n")
+            f.write(text_format.MessageToString(batch_config))
+        output_paths.append(output_path)
+
+    return output_paths
+
+
+# magic bytes and alignment of columnar files, see interface/ColumnarFile.h
+_COLUMNAR_MAGIC = b"TFCOL1\0\0"
+_COLUMNAR_ALIGNMENT = 64
+
+
+def _columnar_align(n):
+    return (n + _COLUMNAR_ALIGNMENT - 1) // _COLUMNAR_ALIGNMENT * _COLUMNAR_ALIGNMENT
+
+
+def write_columnar_file(path, columns):
+    """
+    Writes *columns*, a list of ``(name, values)`` pairs or a mapping, to a columnar file at *path*
+    that can be mapped by ``tensorflow::ColumnarFile`` in C++, e.g. as an input of the ``tfRescore``
+    executable. All values are converted to float32 and must have the same length. Example:
+
+    .. code-block:: python
+
+        write_columnar_file("jets.tfcol", [("pt", jet_pt), ("eta", jet_eta)])
+    """
+    import struct
+    import numpy as np
+
+    if isinstance(columns, dict):
+        columns = list(columns.items())
+    names = [str(name) for name, _ in columns]
+    values = [np.ascontiguousarray(v, dtype=np.float32).reshape(-1) for _, v in columns]
+    n_rows = len(values[0]) if values else 0
+    if any(len(v) != n_rows for v in values):
+        raise ValueError("all columns must have the same length")
+
+    # header
+    header = _COLUMNAR_MAGIC + struct.pack("<QQ", n_rows, len(names))
+    for name in names:
+        encoded = name.encode("utf-8")
+        header += struct.pack("<Q", len(encoded)) + encoded
+    header += b"\0" * (_columnar_align(len(header)) - len(header))
+
+    # columns, each padded to the alignment
+    stride = _columnar_align(n_rows * 4)
+    with open(path, "wb") as f:
+        f.write(header)
+        for v in values:
+            f.write(v.astype("<f4").tobytes())
+            f.write(b"\0" * (stride - n_rows * 4))
+
+
+def read_columnar_file(path, mmap=True):
+    """
+    Reads a columnar file at *path*, e.g. an output of the ``tfRescore`` executable, and returns an
+    ordered dictionary mapping column names to float32 arrays. When *mmap* is *True*, arrays are
+    memory-mapped and read lazily.
+    """
+    import struct
+    import collections
+    import numpy as np
+
+    with open(path, "rb") as f:
+        magic = f.read(len(_COLUMNAR_MAGIC))
+        if magic != _COLUMNAR_MAGIC:
+            raise IOError("file '{}' is not a columnar file".format(path))
+        n_rows, n_columns = struct.unpack("<QQ", f.read(16))
+        names = []
+        for _ in range(n_columns):
+            length, = struct.unpack("<Q", f.read(8))
+            names.append(f.read(length).decode("utf-8"))
+        offset = _columnar_align(f.tell())
+
+    stride = _columnar_align(n_rows * 4)
+    columns = collections.OrderedDict()
+    for i, name in enumerate(names):
+        if mmap:
+            columns[name] = np.memmap(path, dtype="<f4", mode="r", offset=offset + i * stride,
+                shape=(n_rows,))
+        else:
+            with open(path, "rb") as f:
+                f.seek(offset + i * stride)
+                columns[name] = np.fromfile(f, dtype="<f4", count=n_rows)
+    return columns
+
+
+def analyze_model_cost(graph, batch_size=1, input_shapes=None, top=10, verbose=True):
+    """
+    Estimates the cost of a *graph*, given as a path to a constant graph file, a ``GraphDef`` or a
+    ``tf.Graph``, following the same rules as ``tensorflow::analyzeModelCost`` in C++. Unknown
+    dimensions of placeholders are set to *batch_size*, unless placeholders are listed with a full
+    shape in *input_shapes*. A dictionary with the keys ``batch_size``, ``flops``, ``param_bytes``,
+    ``peak_activation_bytes``, ``complete`` (whether all shapes were inferred) and ``ops`` (a list
+    of dictionaries per op in execution order) is returned. When *verbose* is *True*, a summary
+    including the *top* most expensive ops is printed. Example:
+
+    .. code-block:: python
+
+        cost = analyze_model_cost("graph.pb", batch_size=64, input_shapes={"scale": []})
+        # batch size       : 64
+        # flops            : ...
+    """
+    if isinstance(graph, six.string_types):
+        graph = read_constant_graph(graph, create_session=False)
+    graph_def = graph.as_graph_def() if isinstance(graph, tf.Graph) else graph
+    input_shapes = input_shapes or {}
+
+    # set placeholder shapes
+    from tensorflow.core.framework import graph_pb2, tensor_shape_pb2
+    graph_def_copy = graph_pb2.GraphDef()
+    graph_def_copy.CopyFrom(graph_def)
+    for node in graph_def_copy.node:
+        if node.op != "Placeholder":
+            continue
+        if node.name in input_shapes:
+            node.attr["shape"].shape.CopyFrom(tensor_shape_pb2.TensorShapeProto(dim=[
+                tensor_shape_pb2.TensorShapeProto.Dim(size=int(d)) for d in input_shapes[node.name]
+            ]))
+        # a missing shape attribute means an unknown rank, so it must not be created as a scalar shape
+        elif "shape" in node.attr and not node.attr["shape"].shape.unknown_rank:
+            for dim in node.attr["shape"].shape.dim:
+                if dim.size < 0:
+                    dim.size = batch_size
+
+    # import the graph, which infers shapes
+    graph = tf.Graph()
+    with graph.as_default():
+        tf.import_graph_def(graph_def_copy, name="")
+
+    state = {"complete": True}
+
+    def dims(tensor):
+        if tensor.shape.dims is None:
+            state["complete"] = False
+            return []
+        return [(-1 if d is None else d) for d in tensor.shape.as_list()]
+
+    def n_elements(tensor):
+        n = 1
+        if tensor.shape.dims is None:
+            state["complete"] = False
+        else:
+            for d in tensor.shape.as_list():
+                if d is None:
+                    state["complete"] = False
+                else:
+                    n *= d
+        return n
+
+    def dim_at(d, i):
+        j = len(d) + i if i < 0 else i
+        if j < 0 or j >= len(d) or d[j] < 0:
+            state["complete"] = False
+            return 1
+        return d[j]
+
+    elementwise_ops = {"Add", "AddV2", "Sub", "Mul", "RealDiv", "Div", "Maximum", "Minimum",
+        "SquaredDifference", "Neg", "Abs", "Exp", "Log", "Sqrt", "Rsqrt", "Square", "Pow", "BiasAdd",
+        "Relu", "Relu6", "Elu", "Selu", "Sigmoid", "Tanh", "Softplus", "LeakyRelu", "Floor", "Round",
+        "Greater", "Less", "Equal", "Select", "ClipByValue"}
+    reduction_ops = {"Sum", "Mean", "Max", "Min", "Prod", "ArgMax", "ArgMin"}
+    forwarding_ops = {"Identity", "StopGradient", "Snapshot"}
+
+    def count_flops(op):
+        if not op.outputs:
+            return 0
+        n_out = n_elements(op.outputs[0])
+        t = op.type
+        if t == "MatMul":
+            return 2 * n_out * dim_at(dims(op.inputs[0]), 0 if op.get_attr("transpose_a") else 1)
+        elif t in ("BatchMatMul", "BatchMatMulV2"):
+            return 2 * n_out * dim_at(dims(op.inputs[0]), -2 if op.get_attr("adj_x") else -1)
+        elif t in ("Conv2D", "Conv3D"):
+            f = dims(op.inputs[1])
+            k = dim_at(f, 0)
+            for i in range(1, len(f) - 1):
+                k *= dim_at(f, i)
+            return 2 * n_out * k
+        elif t == "DepthwiseConv2dNative":
+            f = dims(op.inputs[1])
+            return 2 * n_out * dim_at(f, 0) * dim_at(f, 1)
+        elif t in ("MaxPool", "AvgPool", "MaxPool3D", "AvgPool3D"):
+            k = 1
+            for s in op.get_attr("ksize"):
+                k *= s
+            return n_out * k
+        elif t in ("FusedBatchNorm", "FusedBatchNormV2", "FusedBatchNormV3"):
+            return 2 * n_out
+        elif t in ("Softmax", "LogSoftmax"):
+            return 3 * n_out
+        elif t in reduction_ops:
+            return n_elements(op.inputs[0])
+        elif t in elementwise_ops:
+            return n_out
+        return 0
+
+    def param_bytes(op):
+        if op.type == "Const":
+            t = op.get_attr("value")
+            if t.dtype == tf.string.as_datatype_enum:
+                return sum(len(s) for s in t.string_val)
+            n = 1
+            for d in t.tensor_shape.dim:
+                n *= d.size
+            return n * tf.as_dtype(t.dtype).size
+        elif op.type in ("VariableV2", "VarHandleOp"):
+            shape = op.get_attr("shape")
+            if shape.dims is None:
+                return 0
+            n = 1
+            for d in shape.as_list():
+                n *= d if d and d > 0 else 1
+            return n * op.get_attr("dtype").size
+        return 0
+
+    # simulate the execution in topological order, see tensorflow::analyzeModelCost
+    n_consumers = {op.name: sum(len(t.consumers()) for t in op.outputs) for op in graph.get_operations()}
+    params, live_bytes = set(), {}
+    current_bytes = peak_bytes = 0
+    ops = []
+    for op in graph.get_operations():
+        output_bytes = 0
+        for t in op.outputs:
+            if t.dtype in (tf.string, tf.resource, tf.variant):
+                continue
+            output_bytes += n_elements(t) * t.dtype.size
+        op_cost = {"name": op.name, "op": op.type, "flops": count_flops(op),
+            "param_bytes": param_bytes(op), "output_bytes": output_bytes}
+
+        is_param = op_cost["param_bytes"] > 0 or (op.type in forwarding_ops and op.inputs and
+            op.inputs[0].op.name in params)
+        if is_param:
+            params.add(op.name)
+        else:
+            live_bytes[op.name] = output_bytes
+            current_bytes += output_bytes
+            peak_bytes = max(peak_bytes, current_bytes)
+
+        for t in op.inputs:
+            n_consumers[t.op.name] -= 1
+            if n_consumers[t.op.name] == 0 and t.op.name in live_bytes:
+                current_bytes -= live_bytes.pop(t.op.name)
+
+        ops.append(op_cost)
+
+    cost = {
+        "batch_size": batch_size,
+        "flops": sum(o["flops"] for o in ops),
+        "param_bytes": sum(o["param_bytes"] for o in ops),
+        "peak_activation_bytes": peak_bytes,
+        "complete": state["complete"],
+        "ops": ops,
+    }
+
+    if verbose:
+        print("batch size       : {}{}".format(batch_size,
+            "" if cost["complete"] else " (some shapes unknown)"))
+        print("flops            : {} ({:.1f} per element)".format(cost["flops"],
+            float(cost["flops"]) / batch_size))
+        print("parameters       : {} B".format(cost["param_bytes"]))
+        print("peak activations : {} B ({:.1f} per element)".format(peak_bytes,
+            float(peak_bytes) / batch_size))
+        for o in sorted((o for o in ops if o["flops"] > 0), key=lambda o: -o["flops"])[:top]:
+            print("  {:>12} flops  {:>5.1f}%  {} ({})".format(o["flops"],
+                100. * o["flops"] / cost["flops"], o["name"], o["op"]))
+
+    return cost
+
+
 def _test():
     """
     Internal test of the above functions based on the deepjet model.
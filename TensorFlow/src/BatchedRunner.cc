@@ -0,0 +1,33 @@
+/*
+ * Batched evaluation of sessions for collections of objects, split into chunks of bounded size.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include "PhysicsTools/TensorFlow/interface/BatchedRunner.h"
+
+namespace tensorflow {
+
+  BatchedRunner::BatchedRunner(Session* session,
+                               const std::string& inputName,
+                               const std::vector<std::string>& featureNames,
+                               const std::vector<std::string>& outputNames,
+                               const NamedTensorList& extraInputs)
+      : session_(session),
+        inputName_(inputName),
+        outputNames_(outputNames),
+        extraInputs_(extraInputs),
+        nFeatures_(featureNames.size()),
+        maxChunkBytes_(256 << 10),
+        parallel_(false),
+        packers_(FeaturePacker(featureNames)) {
+    if (session_ == nullptr) {
+      throw cms::Exception("InvalidSession") << "cannot create batched runner for empty session";
+    }
+  }
+
+  size_t BatchedRunner::chunkSize() const { return std::max(size_t(1), maxChunkBytes_ / (nFeatures_ * sizeof(float))); }
+
+}  // namespace tensorflow
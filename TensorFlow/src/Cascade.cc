@@ -0,0 +1,165 @@
+/*
+ * Cascaded evaluation of a chain of sessions, where each stage only evaluates the rows accepted by
+ * the previous one.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "PhysicsTools/TensorFlow/interface/Cascade.h"
+
+#include "tensorflow/core/framework/tensor_util.h"
+
+namespace tensorflow {
+
+  int64 Cascade::Result::position(size_t stage, int64 row) const {
+    // rows are sorted as compaction keeps their order
+    const std::vector<int64>& stageRows = rows.at(stage);
+    auto it = std::lower_bound(stageRows.begin(), stageRows.end(), row);
+    return it != stageRows.end() && *it == row ? std::distance(stageRows.begin(), it) : -1;
+  }
+
+  int Cascade::Result::lastStage(int64 row) const {
+    int stage = -1;
+    for (size_t i = 0; i < nStages() && position(i, row) >= 0; i++) {
+      stage = i;
+    }
+    return stage;
+  }
+
+  std::vector<float> Cascade::Result::scatter(size_t stage,
+                                              size_t outputIndex,
+                                              int64 column,
+                                              float defaultValue) const {
+    std::vector<float> values(nRows, defaultValue);
+    if (stage >= nStages()) {
+      return values;
+    }
+    const std::vector<int64>& stageRows = rows[stage];
+    if (stageRows.empty()) {
+      return values;
+    }
+    const Tensor& output = outputs[stage].at(outputIndex);
+    int64 nColumns = output.NumElements() / stageRows.size();
+    if (column >= nColumns) {
+      throw cms::Exception("InvalidCascadeOutput")
+          << "column " << column << " out of range for output with " << nColumns << " columns";
+    }
+    if (output.dtype() != DT_FLOAT) {
+      throw cms::Exception("InvalidCascadeOutput") << "output " << outputIndex << " must be a float tensor";
+    }
+    auto flat = output.flat<float>();
+    for (size_t i = 0; i < stageRows.size(); i++) {
+      values[stageRows[i]] = flat(i * nColumns + column);
+    }
+    return values;
+  }
+
+  void Cascade::addStage(Session* session,
+                         const std::string& inputName,
+                         const std::vector<std::string>& outputNames,
+                         Predicate accept,
+                         const NamedTensorList& extraInputs) {
+    if (session == nullptr) {
+      throw cms::Exception("InvalidSession") << "cannot add empty session to cascade";
+    }
+    stages_.push_back({session, inputName, outputNames, accept, extraInputs});
+  }
+
+  Cascade::Predicate Cascade::threshold(float minValue, size_t outputIndex, int64 column) {
+    return [=](const std::vector<Tensor>& outputs, int64 position) {
+      const Tensor& output = outputs.at(outputIndex);
+      if (output.dtype() != DT_FLOAT) {
+        throw cms::Exception("InvalidCascadeOutput") << "output " << outputIndex << " must be a float tensor";
+      }
+      // check the rank before accessing dimensions, which is cheap compared to the run of the stage
+      if (output.dims() != 2 || column < 0 || column >= output.dim_size(1)) {
+        throw cms::Exception("InvalidCascadeOutput")
+            << "output " << outputIndex << " must have rank 2 and more than " << column << " columns, got shape "
+            << output.shape().DebugString();
+      }
+      return output.matrix<float>()(position, column) >= minValue;
+    };
+  }
+
+  void Cascade::run(const Tensor& input, Result* result, const std::string& threadPoolName) {
+    if (stages_.empty()) {
+      throw cms::Exception("InvalidCascade") << "cannot run cascade without stages";
+    }
+    if (input.dims() < 1 || !DataTypeCanUseMemcpy(input.dtype())) {
+      throw cms::Exception("InvalidCascadeInput") << "cascade input must have a batch dimension and a numeric type";
+    }
+
+    // copy the input into the buffer, which is only reallocated when the type, the inner shape or
+    // the capacity changes
+    int64 n = input.dim_size(0);
+    TensorShape innerShape = input.shape();
+    innerShape.RemoveDim(0);
+    bool reuse = buffer_.IsInitialized() && buffer_.dtype() == input.dtype() && buffer_.dims() == input.dims() &&
+                 buffer_.dim_size(0) >= n;
+    for (int i = 1; reuse && i < input.dims(); i++) {
+      reuse = buffer_.dim_size(i) == input.dim_size(i);
+    }
+    if (!reuse) {
+      TensorShape shape = innerShape;
+      shape.InsertDim(0, std::max(n, int64(1)));
+      buffer_ = Tensor(input.dtype(), shape);
+    }
+    Tensor batch = buffer_.Slice(0, n);
+    char* data = const_cast<char*>(batch.tensor_data().data());
+    size_t rowBytes = innerShape.num_elements() * DataTypeSize(input.dtype());
+    if (n > 0) {
+      std::memcpy(data, input.tensor_data().data(), n * rowBytes);
+    }
+
+    result->nRows = n;
+    result->rows.clear();
+    result->outputs.clear();
+    std::vector<int64> rows(n);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    for (size_t i = 0; i < stages_.size() && !rows.empty(); i++) {
+      const Stage& stage = stages_[i];
+
+      // evaluate the stage on the current rows
+      NamedTensorList inputs = stage.extraInputs;
+      inputs.emplace_back(stage.inputName, batch);
+      result->rows.push_back(rows);
+      result->outputs.emplace_back();
+      tensorflow::run(stage.session, inputs, stage.outputNames, &result->outputs.back(), threadPoolName);
+
+      // outputs can alias the buffer, e.g. via identities of the input, which is overwritten by the
+      // compaction and the next run, so they are copied
+      for (Tensor& output : result->outputs.back()) {
+        if (output.IsInitialized() && output.SharesBufferWith(buffer_)) {
+          output = tensor::DeepCopy(output);
+        }
+      }
+
+      if (i == stages_.size() - 1 || !stage.accept) {
+        continue;
+      }
+
+      // move accepted rows to the front, keeping their order
+      int64 nAccepted = 0;
+      for (size_t j = 0; j < rows.size(); j++) {
+        if (!stage.accept(result->outputs.back(), j)) {
+          continue;
+        }
+        if (nAccepted != int64(j)) {
+          std::memmove(data + nAccepted * rowBytes, data + j * rowBytes, rowBytes);
+          rows[nAccepted] = rows[j];
+        }
+        nAccepted++;
+      }
+      rows.resize(nAccepted);
+      batch = buffer_.Slice(0, nAccepted);
+    }
+  }
+
+}  // namespace tensorflow
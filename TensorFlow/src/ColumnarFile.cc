@@ -0,0 +1,189 @@
+/*
+ * Memory-mapped files storing float32 features in columns, used for offline evaluation of large
+ * numbers of objects outside the framework.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PhysicsTools/TensorFlow/interface/ColumnarFile.h"
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+namespace tensorflow {
+
+  namespace {
+
+    const char kMagic[8] = {'T', 'F', 'C', 'O', 'L', '1', '\0', '\0'};
+
+    const size_t kAlignment = 64;
+
+    size_t align(size_t n) { return (n + kAlignment - 1) / kAlignment * kAlignment; }
+
+  }  // namespace
+
+  size_t ColumnarFile::columnStride(size_t nRows) { return align(nRows * sizeof(float)); }
+
+  size_t ColumnarFile::headerSize(const std::vector<std::string>& columnNames) {
+    size_t size = sizeof(kMagic) + 2 * sizeof(uint64_t);
+    for (const std::string& name : columnNames) {
+      size += sizeof(uint64_t) + name.size();
+    }
+    return align(size);
+  }
+
+  ColumnarFile::ColumnarFile(const std::string& path) : path_(path), data_(nullptr), size_(0), nRows_(0) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw cms::Exception("InvalidColumnarFile") << "error while opening " << path << ": " << std::strerror(errno);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(kMagic) + 2 * sizeof(uint64_t)) {
+      ::close(fd);
+      throw cms::Exception("InvalidColumnarFile") << "file " << path << " is too small";
+    }
+    size_ = st.st_size;
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      throw cms::Exception("InvalidColumnarFile") << "error while mapping " << path << ": " << std::strerror(errno);
+    }
+
+    // columns are read front to back
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+
+    // parse the header with bounds checks, unmapping on failure
+    const char* bytes = static_cast<const char*>(data_);
+    size_t offset = 0;
+    auto read = [&](void* dst, size_t n) {
+      if (offset + n > size_) {
+        ::munmap(data_, size_);
+        throw cms::Exception("InvalidColumnarFile") << "truncated header in " << path;
+      }
+      std::memcpy(dst, bytes + offset, n);
+      offset += n;
+    };
+    char magic[sizeof(kMagic)];
+    uint64_t nRows, nColumns;
+    read(magic, sizeof(magic));
+    if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+      ::munmap(data_, size_);
+      throw cms::Exception("InvalidColumnarFile") << "file " << path << " is not a columnar file";
+    }
+    read(&nRows, sizeof(nRows));
+    read(&nColumns, sizeof(nColumns));
+    for (uint64_t i = 0; i < nColumns; i++) {
+      uint64_t length;
+      read(&length, sizeof(length));
+      std::string name(std::min(size_t(length), size_), '\0');
+      read(&name[0], name.size());
+      columnNames_.push_back(name);
+    }
+    nRows_ = nRows;
+
+    // check the size without overflows for corrupted headers and locate the columns
+    size_t dataOffset = headerSize(columnNames_);
+    bool tooSmall = dataOffset > size_;
+    if (!tooSmall && nColumns > 0) {
+      size_t dataSize = size_ - dataOffset;
+      tooSmall = nRows_ > dataSize / sizeof(float) ||
+                 (columnStride(nRows_) > 0 && nColumns > dataSize / columnStride(nRows_));
+    }
+    if (tooSmall) {
+      ::munmap(data_, size_);
+      throw cms::Exception("InvalidColumnarFile") << "file " << path << " is too small for " << nRows_ << " rows";
+    }
+    for (uint64_t i = 0; i < nColumns; i++) {
+      columns_.push_back(reinterpret_cast<const float*>(bytes + dataOffset + i * columnStride(nRows_)));
+    }
+  }
+
+  ColumnarFile::~ColumnarFile() {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+  }
+
+  size_t ColumnarFile::columnIndex(const std::string& columnName) const {
+    auto it = std::find(columnNames_.begin(), columnNames_.end(), columnName);
+    if (it == columnNames_.end()) {
+      throw cms::Exception("UnknownColumn") << "column '" << columnName << "' not found in " << path_;
+    }
+    return std::distance(columnNames_.begin(), it);
+  }
+
+  ColumnarFileWriter::ColumnarFileWriter(const std::string& path,
+                                         const std::vector<std::string>& columnNames,
+                                         size_t nRows)
+      : path_(path), data_(nullptr), size_(0), nRows_(nRows) {
+    size_t dataOffset = ColumnarFile::headerSize(columnNames);
+    size_ = dataOffset + columnNames.size() * ColumnarFile::columnStride(nRows);
+
+    // create the file at its final size and map it
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw cms::Exception("InvalidColumnarFile") << "error while creating " << path << ": " << std::strerror(errno);
+    }
+    if (::ftruncate(fd, size_) != 0) {
+      ::close(fd);
+      throw cms::Exception("InvalidColumnarFile") << "error while resizing " << path << ": " << std::strerror(errno);
+    }
+    data_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      throw cms::Exception("InvalidColumnarFile") << "error while mapping " << path << ": " << std::strerror(errno);
+    }
+
+    // write the header, padding and unwritten values are zero after truncation
+    char* bytes = static_cast<char*>(data_);
+    size_t offset = 0;
+    auto write = [&](const void* src, size_t n) {
+      std::memcpy(bytes + offset, src, n);
+      offset += n;
+    };
+    uint64_t n = nRows, nColumns = columnNames.size();
+    write(kMagic, sizeof(kMagic));
+    write(&n, sizeof(n));
+    write(&nColumns, sizeof(nColumns));
+    for (const std::string& name : columnNames) {
+      uint64_t length = name.size();
+      write(&length, sizeof(length));
+      write(name.data(), name.size());
+    }
+
+    for (size_t i = 0; i < columnNames.size(); i++) {
+      columns_.push_back(reinterpret_cast<float*>(bytes + dataOffset + i * ColumnarFile::columnStride(nRows)));
+    }
+  }
+
+  ColumnarFileWriter::~ColumnarFileWriter() {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+  }
+
+  void ColumnarFileWriter::close() {
+    if (data_ == nullptr) {
+      return;
+    }
+    int status = ::msync(data_, size_, MS_SYNC);
+    ::munmap(data_, size_);
+    data_ = nullptr;
+    columns_.clear();
+    if (status != 0) {
+      throw cms::Exception("InvalidColumnarFile") << "error while syncing " << path_ << ": " << std::strerror(errno);
+    }
+  }
+
+}  // namespace tensorflow
@@ -0,0 +1,104 @@
+/*
+ * Helpers to pack features of physics objects into batched, padded or ragged input tensors.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <cstring>
+
+#include "PhysicsTools/TensorFlow/interface/FeaturePacker.h"
+
+namespace tensorflow {
+
+  FeaturePacker::FeaturePacker(const std::vector<std::string>& featureNames)
+      : featureNames_(featureNames), buffers_(kNSlots) {
+    if (featureNames_.empty()) {
+      throw cms::Exception("InvalidFeaturePacker") << "at least one feature is required";
+    }
+    for (size_t i = 0; i < featureNames_.size(); i++) {
+      if (std::find(featureNames_.begin() + i + 1, featureNames_.end(), featureNames_[i]) != featureNames_.end()) {
+        throw cms::Exception("InvalidFeaturePacker") << "feature '" << featureNames_[i] << "' declared twice";
+      }
+    }
+  }
+
+  size_t FeaturePacker::featureIndex(const std::string& featureName) const {
+    auto it = std::find(featureNames_.begin(), featureNames_.end(), featureName);
+    if (it == featureNames_.end()) {
+      throw cms::Exception("UnknownFeature") << "feature '" << featureName << "' not declared";
+    }
+    return std::distance(featureNames_.begin(), it);
+  }
+
+  Tensor FeaturePacker::packColumns(const std::vector<const float*>& columns, size_t n) {
+    if (columns.size() != nFeatures()) {
+      throw cms::Exception("InvalidFeatureColumns")
+          << "expected " << nFeatures() << " feature columns, got " << columns.size();
+    }
+
+    Tensor tensor = buffer(kBatch, DT_FLOAT, n, {});
+    float* data = tensor.flat<float>().data();
+    size_t nf = nFeatures();
+
+    // a single column is already in the final layout
+    if (nf == 1) {
+      std::memcpy(data, columns[0], n * sizeof(float));
+      return tensor;
+    }
+
+    // transpose in blocks of rows so that reads from all columns and writes stay within cache
+    const size_t blockSize = 64;
+    for (size_t start = 0; start < n; start += blockSize) {
+      size_t end = std::min(start + blockSize, n);
+      for (size_t f = 0; f < nf; f++) {
+        const float* column = columns[f];
+        for (size_t i = start; i < end; i++) {
+          data[i * nf + f] = column[i];
+        }
+      }
+    }
+
+    return tensor;
+  }
+
+  Tensor FeaturePacker::buffer(BufferSlot slot, DataType dtype, size_t n, const std::vector<int64>& innerDims) {
+    // build the shape without the batch dimension
+    TensorShape innerShape;
+    for (int64 dim : innerDims) {
+      innerShape.AddDim(dim);
+    }
+    if (slot != kRowSplits) {
+      innerShape.AddDim(nFeatures());
+    }
+
+    // reuse the buffer when it is no longer referenced by previously returned tensors, the data
+    // type and inner shape match and the capacity suffices
+    // slices starting at the first row share the buffer and keep its alignment
+    Tensor& buf = buffers_[slot];
+    if (buf.IsInitialized() && buf.RefCountIsOne() && buf.dtype() == dtype && buf.dims() == innerShape.dims() + 1) {
+      bool sameInnerShape = true;
+      for (int i = 0; i < innerShape.dims(); i++) {
+        sameInnerShape &= buf.dim_size(i + 1) == innerShape.dim_size(i);
+      }
+      if (sameInnerShape && size_t(buf.dim_size(0)) >= n && n > 0) {
+        return buf.Slice(0, n);
+      }
+    }
+
+    // allocate a new buffer with some headroom to reduce reallocations for growing batches
+    TensorShape shape = innerShape;
+    shape.InsertDim(0, n);
+    if (n == 0) {
+      return Tensor(dtype, shape);
+    }
+    size_t capacity = buf.IsInitialized() && buf.dims() > 0 ? std::max(n, size_t(buf.dim_size(0) * 3 / 2)) : n;
+    TensorShape capacityShape = innerShape;
+    capacityShape.InsertDim(0, capacity);
+    buf = Tensor(dtype, capacityShape);
+
+    return buf.Slice(0, n);
+  }
+
+}  // namespace tensorflow
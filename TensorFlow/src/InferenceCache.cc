@@ -0,0 +1,202 @@
+/*
+ * Bounded, concurrent LRU cache of inference results.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <algorithm>
+
+#include "PhysicsTools/TensorFlow/interface/InferenceCache.h"
+
+#include "tensorflow/core/platform/fingerprint.h"
+
+namespace tensorflow {
+
+  namespace {
+
+    void addFingerprint(InferenceCache::Key& key, StringPiece data) {
+      Fprint128 fp = Fingerprint128(data);
+      key.low = FingerprintCat64(key.low, fp.low64);
+      key.high = FingerprintCat64(key.high, fp.high64);
+    }
+
+    void addFingerprint(InferenceCache::Key& key, int64 value) {
+      addFingerprint(key, StringPiece(reinterpret_cast<const char*>(&value), sizeof(value)));
+    }
+
+    size_t nShardsOrOne(size_t nShards) { return nShards > 0 ? nShards : 1; }
+
+    size_t totalBytes(const std::vector<Tensor>& tensors) {
+      size_t bytes = 0;
+      for (const Tensor& tensor : tensors) {
+        bytes += tensor.TotalBytes();
+      }
+      return bytes;
+    }
+
+  }  // namespace
+
+  InferenceCache::InferenceCache(size_t maxEntries, size_t maxBytes, size_t nShards)
+      : maxEntriesPerShard_(std::max(size_t(1), (maxEntries + nShardsOrOne(nShards) - 1) / nShardsOrOne(nShards))),
+        maxBytesPerShard_(maxBytes / nShardsOrOne(nShards)),
+        hits_(0),
+        misses_(0),
+        evictions_(0) {
+    for (size_t i = 0; i < nShardsOrOne(nShards); i++) {
+      shards_.emplace_back(new Shard());
+    }
+  }
+
+  InferenceCache::Key InferenceCache::key(const std::string& modelId,
+                                          const NamedTensorList& inputs,
+                                          const std::vector<std::string>& outputNames) {
+    Key key = {0, 0, Fingerprint64(modelId)};
+    addFingerprint(key, modelId);
+
+    for (const NamedTensor& input : inputs) {
+      const Tensor& tensor = input.second;
+      addFingerprint(key, input.first);
+      addFingerprint(key, int64(tensor.dtype()));
+      addFingerprint(key, int64(tensor.dims()));
+      for (int i = 0; i < tensor.dims(); i++) {
+        addFingerprint(key, tensor.dim_size(i));
+      }
+      if (tensor.dtype() == DT_STRING) {
+        auto flat = tensor.flat<std::string>();
+        for (int64 i = 0; i < flat.size(); i++) {
+          addFingerprint(key, flat(i));
+        }
+      } else {
+        addFingerprint(key, tensor.tensor_data());
+      }
+    }
+
+    // separate inputs from outputs
+    addFingerprint(key, int64(-1));
+    for (const std::string& outputName : outputNames) {
+      addFingerprint(key, outputName);
+    }
+
+    return key;
+  }
+
+  bool InferenceCache::lookup(const Key& key, std::vector<Tensor>* outputs) {
+    Shard& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+      s.counts[key.model].misses++;
+      misses_++;
+      return false;
+    }
+
+    // move the entry to the front
+    s.entries.splice(s.entries.begin(), s.entries, it->second);
+    *outputs = it->second->outputs;
+    s.counts[key.model].hits++;
+    hits_++;
+    return true;
+  }
+
+  void InferenceCache::insert(const Key& key, const std::vector<Tensor>& outputs) {
+    size_t bytes = totalBytes(outputs);
+
+    // entries that would not fit into an empty shard are not stored at all
+    if (maxBytesPerShard_ > 0 && bytes > maxBytesPerShard_) {
+      return;
+    }
+
+    Shard& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    // update existing entries, e.g. when inserted concurrently by another thread
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+      s.bytes -= it->second->bytes;
+      s.entries.erase(it->second);
+      s.index.erase(it);
+    }
+
+    // evict least recently used entries
+    while (!s.entries.empty() && (s.entries.size() >= maxEntriesPerShard_ ||
+                                  (maxBytesPerShard_ > 0 && s.bytes + bytes > maxBytesPerShard_))) {
+      s.bytes -= s.entries.back().bytes;
+      s.index.erase(s.entries.back().key);
+      s.counts[s.entries.back().key.model].evictions++;
+      s.entries.pop_back();
+      evictions_++;
+    }
+
+    s.entries.push_front({key, outputs, bytes});
+    s.index[key] = s.entries.begin();
+    s.bytes += bytes;
+  }
+
+  InferenceCache::Stats InferenceCache::stats() const {
+    Stats stats = {hits_, misses_, evictions_, 0, 0};
+    for (const auto& s : shards_) {
+      std::lock_guard<std::mutex> lock(s->mutex);
+      stats.entries += s->entries.size();
+      stats.bytes += s->bytes;
+    }
+    return stats;
+  }
+
+  InferenceCache::Stats InferenceCache::stats(const std::string& modelId) const {
+    uint64 model = Fingerprint64(modelId);
+    Stats stats = {0, 0, 0, 0, 0};
+    for (const auto& s : shards_) {
+      std::lock_guard<std::mutex> lock(s->mutex);
+      auto it = s->counts.find(model);
+      if (it != s->counts.end()) {
+        stats.hits += it->second.hits;
+        stats.misses += it->second.misses;
+        stats.evictions += it->second.evictions;
+      }
+      for (const Entry& entry : s->entries) {
+        if (entry.key.model == model) {
+          stats.entries++;
+          stats.bytes += entry.bytes;
+        }
+      }
+    }
+    return stats;
+  }
+
+  void InferenceCache::clear() {
+    for (auto& s : shards_) {
+      std::lock_guard<std::mutex> lock(s->mutex);
+      s->entries.clear();
+      s->index.clear();
+      s->bytes = 0;
+      s->counts.clear();
+    }
+    hits_ = 0;
+    misses_ = 0;
+    evictions_ = 0;
+  }
+
+  void run(InferenceCache* cache,
+           const std::string& modelId,
+           Session* session,
+           const NamedTensorList& inputs,
+           const std::vector<std::string>& outputNames,
+           std::vector<Tensor>* outputs,
+           const std::string& threadPoolName) {
+    if (cache == nullptr) {
+      run(session, inputs, outputNames, outputs, threadPoolName);
+      return;
+    }
+
+    InferenceCache::Key key = InferenceCache::key(modelId, inputs, outputNames);
+    if (cache->lookup(key, outputs)) {
+      return;
+    }
+
+    run(session, inputs, outputNames, outputs, threadPoolName);
+    cache->insert(key, *outputs);
+  }
+
+}  // namespace tensorflow
@@ -0,0 +1,231 @@
+/*
+ * Memory accounting for sessions created via the TensorFlow interface.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include "PhysicsTools/TensorFlow/interface/MemoryTracker.h"
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
+
+namespace tensorflow {
+
+  int64 estimateWeightBytes(const NodeDef& node) {
+    int64 bytes = 0;
+    if (node.op() == "Const") {
+      // use the shape and type instead of parsing the tensor
+      const TensorProto& tensor = node.attr().at("value").tensor();
+      int64 nElements = TensorShape(tensor.tensor_shape()).num_elements();
+      if (tensor.dtype() == DT_STRING) {
+        for (const std::string& s : tensor.string_val()) {
+          bytes += s.size();
+        }
+      } else {
+        bytes += nElements * DataTypeSize(tensor.dtype());
+      }
+    } else if (node.op() == "VariableV2" || node.op() == "VarHandleOp") {
+      auto shape = node.attr().find("shape");
+      auto dtype = node.attr().find("dtype");
+      if (shape != node.attr().end() && dtype != node.attr().end() && !shape->second.shape().unknown_rank()) {
+        int64 nElements = 1;
+        for (const auto& dim : shape->second.shape().dim()) {
+          nElements *= dim.size() > 0 ? dim.size() : 1;
+        }
+        bytes += nElements * DataTypeSize(dtype->second.type());
+      }
+    }
+    return bytes;
+  }
+
+  int64 estimateWeightBytes(const GraphDef& graphDef) {
+    int64 bytes = 0;
+    for (const NodeDef& node : graphDef.node()) {
+      bytes += estimateWeightBytes(node);
+    }
+    return bytes;
+  }
+
+  void MemoryTracker::setEnabled(bool enabled) {
+    enabled_ = enabled;
+    EnableCPUAllocatorStats(enabled);
+  }
+
+  void MemoryTracker::registerSession(const Session* session, int64 weightBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // check the budget, ignoring the weights of a previous registration of the same session
+    auto it = sessions_.find(session);
+    int64 otherBytes = totalBytesLocked() - (it == sessions_.end() ? 0 : it->second.weightBytes);
+    if (budget_ > 0 && otherBytes + weightBytes > budget_) {
+      throw cms::Exception("MemoryBudgetExceeded")
+          << "creating a session with " << weightBytes << " bytes of weights would exceed the memory budget of "
+          << budget_ << " bytes, " << otherBytes << " bytes are held by existing sessions";
+    }
+
+    if (it == sessions_.end()) {
+      sessions_[session] = {"session_" + std::to_string(sessionCounter_++), weightBytes, 0, 0, 0, 0, 0};
+    } else {
+      it->second.weightBytes = weightBytes;
+    }
+  }
+
+  void MemoryTracker::unregisterSession(const Session* session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.erase(session);
+  }
+
+  void MemoryTracker::setSessionName(const Session* session, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(session);
+    if (it == sessions_.end()) {
+      throw cms::Exception("UnknownSession") << "cannot set name '" << name << "' of unregistered session";
+    }
+    it->second.name = name;
+  }
+
+  bool MemoryTracker::beginRun(const Session* session, int64 inputBytes, int64* reservedBytes) {
+    *reservedBytes = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(session);
+    if (it == sessions_.end()) {
+      return false;
+    }
+    Stats& stats = it->second;
+
+    // expect the run to allocate as much as the largest run so far, plus its inputs, on top of the
+    // weights of all sessions and the reservations of other runs in flight
+    int64 expectedBytes = stats.peakRunBytes + inputBytes;
+    if (budget_ > 0) {
+      int64 totalBytes = totalBytesLocked() + expectedBytes;
+      if (totalBytes > budget_) {
+        throw cms::Exception("MemoryBudgetExceeded")
+            << "running session '" << stats.name << "' is expected to use " << expectedBytes << " bytes, "
+            << totalBytes << " bytes in total which exceeds the memory budget of " << budget_ << " bytes";
+      }
+    }
+
+    // reserve the expected bytes until the run ends
+    stats.reservedBytes += expectedBytes;
+    *reservedBytes = expectedBytes;
+
+    return stats.nRuns++ % traceInterval_ == 0;
+  }
+
+  void MemoryTracker::endRun(const Session* session,
+                             const RunMetadata* runMetadata,
+                             int64 outputBytes,
+                             int64 reservedBytes) {
+    // estimate the peak of the run by the largest peak of a single node per allocator, summed over
+    // allocators, but at least by the bytes of its outputs
+    int64 runBytes = 0;
+    if (runMetadata != nullptr) {
+      std::map<std::string, int64> allocatorPeaks;
+      for (const DeviceStepStats& deviceStats : runMetadata->step_stats().dev_stats()) {
+        for (const NodeExecStats& nodeStats : deviceStats.node_stats()) {
+          for (const AllocatorMemoryUsed& memory : nodeStats.memory()) {
+            int64& peak = allocatorPeaks[memory.allocator_name()];
+            peak = std::max(peak, memory.peak_bytes());
+          }
+        }
+      }
+      for (const auto& it : allocatorPeaks) {
+        runBytes += it.second;
+      }
+      runBytes = std::max(runBytes, outputBytes);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(session);
+    if (it == sessions_.end()) {
+      return;
+    }
+    Stats& stats = it->second;
+    stats.reservedBytes -= reservedBytes;
+    if (runMetadata != nullptr) {
+      stats.nTracedRuns++;
+      stats.lastRunBytes = runBytes;
+      stats.peakRunBytes = std::max(stats.peakRunBytes, runBytes);
+    }
+  }
+
+  void MemoryTracker::cancelRun(const Session* session, int64 reservedBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(session);
+    if (it != sessions_.end()) {
+      it->second.reservedBytes -= reservedBytes;
+    }
+  }
+
+  MemoryTracker::Stats MemoryTracker::sessionStats(const Session* session) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(session);
+    if (it == sessions_.end()) {
+      throw cms::Exception("UnknownSession") << "cannot get memory stats of unregistered session";
+    }
+    return it->second;
+  }
+
+  std::vector<MemoryTracker::Stats> MemoryTracker::modelStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, Stats> models;
+    for (const auto& it : sessions_) {
+      const Stats& stats = it.second;
+      auto model = models.find(stats.name);
+      if (model == models.end()) {
+        models[stats.name] = stats;
+      } else {
+        model->second.weightBytes += stats.weightBytes;
+        model->second.lastRunBytes += stats.lastRunBytes;
+        model->second.peakRunBytes += stats.peakRunBytes;
+        model->second.reservedBytes += stats.reservedBytes;
+        model->second.nRuns += stats.nRuns;
+        model->second.nTracedRuns += stats.nTracedRuns;
+      }
+    }
+
+    std::vector<Stats> result;
+    for (const auto& it : models) {
+      result.push_back(it.second);
+    }
+    return result;
+  }
+
+  int64 MemoryTracker::totalBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totalBytesLocked();
+  }
+
+  int64 MemoryTracker::totalBytesLocked() const {
+    int64 bytes = 0;
+    for (const auto& it : sessions_) {
+      bytes += it.second.currentBytes();
+    }
+    return bytes;
+  }
+
+  int64 MemoryTracker::allocatorBytesInUse() const {
+    absl::optional<AllocatorStats> stats = cpu_allocator()->GetStats();
+    return stats ? stats->bytes_in_use : -1;
+  }
+
+  void MemoryTracker::report() const {
+    edm::LogInfo log("PhysicsTools/TensorFlow");
+    log << "memory usage of TensorFlow sessions (budget: " << budget_ << " bytes)";
+    for (const Stats& stats : modelStats()) {
+      log << "\n  " << stats.name << ": current " << stats.currentBytes() << " bytes, peak " << stats.peakBytes()
+          << " bytes, weights " << stats.weightBytes << " bytes, " << stats.nTracedRuns << "/" << stats.nRuns
+          << " runs traced";
+    }
+    log << "\n  total: " << totalBytes() << " bytes, cpu allocator: " << allocatorBytesInUse() << " bytes in use";
+  }
+
+}  // namespace tensorflow
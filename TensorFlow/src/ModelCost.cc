@@ -0,0 +1,281 @@
+/*
+ * Static cost analysis of graphs, estimating floating point operations, parameter bytes and peak
+ * activation memory from shapes inferred for a given batch size.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+#include "PhysicsTools/TensorFlow/interface/ModelCost.h"
+
+#include "tensorflow/core/common_runtime/shape_refiner.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+
+namespace tensorflow {
+
+  namespace {
+
+    // ops costing one flop per output element
+    const std::set<std::string> kElementwiseOps = {
+        "Add",   "AddV2",   "Sub",   "Mul",     "RealDiv", "Div",       "Maximum", "Minimum", "SquaredDifference",
+        "Neg",   "Abs",     "Exp",   "Log",     "Sqrt",    "Rsqrt",     "Square",  "Pow",     "BiasAdd",
+        "Relu",  "Relu6",   "Elu",   "Selu",    "Sigmoid", "Tanh",      "Softplus", "LeakyRelu", "Floor",
+        "Round", "Greater", "Less",  "Equal",   "Select",  "ClipByValue"};
+
+    // ops costing one flop per input element
+    const std::set<std::string> kReductionOps = {"Sum", "Mean", "Max", "Min", "Prod", "ArgMax", "ArgMin"};
+
+    // ops forwarding their first input
+    const std::set<std::string> kForwardingOps = {"Identity", "StopGradient", "Snapshot"};
+
+    // returns the dimensions of shape with -1 for unknown ones, or an empty vector for unknown ranks
+    std::vector<int64> getDims(shape_inference::InferenceContext* ctx, shape_inference::ShapeHandle shape) {
+      std::vector<int64> dims;
+      if (ctx->RankKnown(shape)) {
+        for (int i = 0; i < ctx->Rank(shape); i++) {
+          dims.push_back(ctx->Value(ctx->Dim(shape, i)));
+        }
+      }
+      return dims;
+    }
+
+    // returns the number of elements of shape, counting unknown dimensions as 1 and flagging them
+    int64 nElements(shape_inference::InferenceContext* ctx, shape_inference::ShapeHandle shape, bool* complete) {
+      if (!ctx->RankKnown(shape)) {
+        *complete = false;
+        return 1;
+      }
+      int64 n = 1;
+      for (int64 dim : getDims(ctx, shape)) {
+        if (dim < 0) {
+          *complete = false;
+        } else {
+          n *= dim;
+        }
+      }
+      return n;
+    }
+
+    // returns a dimension of dims counted from the front, or from the back when negative
+    int64 dimAt(const std::vector<int64>& dims, int i, bool* complete) {
+      int j = i < 0 ? int(dims.size()) + i : i;
+      if (j < 0 || j >= int(dims.size()) || dims[j] < 0) {
+        *complete = false;
+        return 1;
+      }
+      return dims[j];
+    }
+
+    int64 countFlops(const Node* node, shape_inference::InferenceContext* ctx, bool* complete) {
+      const std::string& op = node->type_string();
+      if (ctx == nullptr || ctx->num_outputs() == 0) {
+        return 0;
+      }
+      int64 nOut = nElements(ctx, ctx->output(0), complete);
+
+      if (op == "MatMul") {
+        bool transposeA = false;
+        GetNodeAttr(node->attrs(), "transpose_a", &transposeA).IgnoreError();
+        std::vector<int64> a = getDims(ctx, ctx->input(0));
+        return 2 * nOut * dimAt(a, transposeA ? 0 : 1, complete);
+      } else if (op == "BatchMatMul" || op == "BatchMatMulV2") {
+        bool adjX = false;
+        GetNodeAttr(node->attrs(), "adj_x", &adjX).IgnoreError();
+        std::vector<int64> a = getDims(ctx, ctx->input(0));
+        return 2 * nOut * dimAt(a, adjX ? -2 : -1, complete);
+      } else if (op == "Conv2D" || op == "Conv3D") {
+        // filter of shape {spatial..., in, out}
+        std::vector<int64> filter = getDims(ctx, ctx->input(1));
+        int64 k = dimAt(filter, 0, complete);
+        for (int i = 1; i < int(filter.size()) - 1; i++) {
+          k *= dimAt(filter, i, complete);
+        }
+        return 2 * nOut * k;
+      } else if (op == "DepthwiseConv2dNative") {
+        // filter of shape {height, width, in, multiplier}
+        std::vector<int64> filter = getDims(ctx, ctx->input(1));
+        return 2 * nOut * dimAt(filter, 0, complete) * dimAt(filter, 1, complete);
+      } else if (op == "MaxPool" || op == "AvgPool" || op == "MaxPool3D" || op == "AvgPool3D") {
+        std::vector<int32> ksize;
+        GetNodeAttr(node->attrs(), "ksize", &ksize).IgnoreError();
+        int64 k = 1;
+        for (int32 s : ksize) {
+          k *= s;
+        }
+        return nOut * k;
+      } else if (op == "FusedBatchNorm" || op == "FusedBatchNormV2" || op == "FusedBatchNormV3") {
+        // scale and shift at inference time
+        return 2 * nOut;
+      } else if (op == "Softmax" || op == "LogSoftmax") {
+        // exponential, sum and division
+        return 3 * nOut;
+      } else if (kReductionOps.count(op)) {
+        return nElements(ctx, ctx->input(0), complete);
+      } else if (kElementwiseOps.count(op)) {
+        return nOut;
+      }
+      return 0;
+    }
+
+    std::string formatBytes(int64 bytes) {
+      std::ostringstream ss;
+      ss << std::fixed << std::setprecision(1);
+      if (bytes >= (1LL << 20)) {
+        ss << bytes / double(1LL << 20) << " MB";
+      } else if (bytes >= (1LL << 10)) {
+        ss << bytes / double(1LL << 10) << " kB";
+      } else {
+        ss << bytes << " B";
+      }
+      return ss.str();
+    }
+
+  }  // namespace
+
+  std::string ModelCost::report(size_t nTop) const {
+    std::ostringstream ss;
+    ss << "batch size       : " << batchSize << (complete ? "" : " (some shapes unknown)") << std::endl
+       << "flops            : " << flops << " (" << flopsPerElement() << " per element)" << std::endl
+       << "parameters       : " << formatBytes(paramBytes) << std::endl
+       << "peak activations : " << formatBytes(peakActivationBytes) << " ("
+       << formatBytes(int64(peakActivationBytesPerElement())) << " per element)" << std::endl;
+
+    // most expensive ops
+    std::vector<const OpCost*> sorted;
+    for (const OpCost& opCost : ops) {
+      if (opCost.flops > 0) {
+        sorted.push_back(&opCost);
+      }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const OpCost* a, const OpCost* b) { return a->flops > b->flops; });
+    if (sorted.size() > nTop) {
+      sorted.resize(nTop);
+    }
+    for (const OpCost* opCost : sorted) {
+      ss << "  " << std::setw(12) << opCost->flops << " flops  " << std::setw(6) << std::fixed << std::setprecision(1)
+         << 100. * opCost->flops / flops << "%  " << opCost->name << " (" << opCost->op << ")" << std::endl;
+    }
+
+    return ss.str();
+  }
+
+  ModelCost analyzeModelCost(const GraphDef& graphDef,
+                             int64 batchSize,
+                             const std::map<std::string, TensorShape>& inputShapes) {
+    if (batchSize <= 0) {
+      throw cms::Exception("InvalidBatchSize") << "batch size must be positive, got " << batchSize;
+    }
+
+    // set placeholder shapes
+    GraphDef gd(graphDef);
+    for (NodeDef& node : *gd.mutable_node()) {
+      if (node.op() != "Placeholder") {
+        continue;
+      }
+      auto it = inputShapes.find(node.name());
+      if (it != inputShapes.end()) {
+        it->second.AsProto((*node.mutable_attr())["shape"].mutable_shape());
+        continue;
+      }
+      // a missing shape attribute means an unknown rank, so it must not be created as a scalar shape
+      auto attr = node.mutable_attr()->find("shape");
+      if (attr != node.mutable_attr()->end() && !attr->second.shape().unknown_rank()) {
+        for (auto& dim : *attr->second.mutable_shape()->mutable_dim()) {
+          if (dim.size() < 0) {
+            dim.set_size(batchSize);
+          }
+        }
+      }
+    }
+
+    // import the graph and infer shapes
+    Graph graph(OpRegistry::Global());
+    ShapeRefiner refiner(gd.versions().producer(), graph.op_registry());
+    Status status = ImportGraphDef(ImportGraphDefOptions(), gd, &graph, &refiner);
+    if (!status.ok()) {
+      throw cms::Exception("InvalidGraphDef") << "error while importing graph for cost analysis: " << status.ToString();
+    }
+
+    ModelCost cost;
+    cost.batchSize = batchSize;
+    cost.flops = 0;
+    cost.paramBytes = 0;
+    cost.peakActivationBytes = 0;
+    cost.complete = true;
+
+    // count data consumers per node to determine the lifetime of outputs
+    std::map<const Node*, int> nConsumers;
+    for (const Edge* edge : graph.edges()) {
+      if (!edge->IsControlEdge() && edge->src()->IsOp() && edge->dst()->IsOp()) {
+        nConsumers[edge->src()]++;
+      }
+    }
+
+    // simulate the execution in topological order, where outputs are allocated when a node runs
+    // and released after its last consumer ran, while parameters and nodes forwarding them are
+    // not considered activations
+    std::vector<Node*> order;
+    GetReversePostOrder(graph, &order);
+    std::set<const Node*> params;
+    std::map<const Node*, int64> liveBytes;
+    int64 currentBytes = 0;
+    for (const Node* node : order) {
+      if (!node->IsOp()) {
+        continue;
+      }
+      shape_inference::InferenceContext* ctx = refiner.GetContext(node);
+
+      OpCost opCost;
+      opCost.name = node->name();
+      opCost.op = node->type_string();
+      opCost.flops = countFlops(node, ctx, &cost.complete);
+      opCost.paramBytes = estimateWeightBytes(node->def());
+      opCost.outputBytes = 0;
+      for (int i = 0; ctx != nullptr && i < node->num_outputs(); i++) {
+        bool complete = true;
+        opCost.outputBytes += nElements(ctx, ctx->output(i), &complete) * DataTypeSize(node->output_type(i));
+        cost.complete &= complete || DataTypeSize(node->output_type(i)) == 0;
+      }
+
+      const Node* forwarded = nullptr;
+      if (kForwardingOps.count(opCost.op) && node->num_inputs() > 0) {
+        node->input_node(0, &forwarded).IgnoreError();
+      }
+      bool isParam = opCost.paramBytes > 0 || (forwarded != nullptr && params.count(forwarded));
+
+      if (isParam) {
+        params.insert(node);
+      } else {
+        liveBytes[node] = opCost.outputBytes;
+        currentBytes += opCost.outputBytes;
+        cost.peakActivationBytes = std::max(cost.peakActivationBytes, currentBytes);
+      }
+
+      // release inputs whose consumers all ran
+      for (const Edge* edge : node->in_edges()) {
+        if (edge->IsControlEdge() || !edge->src()->IsOp()) {
+          continue;
+        }
+        if (--nConsumers[edge->src()] == 0 && liveBytes.count(edge->src())) {
+          currentBytes -= liveBytes[edge->src()];
+          liveBytes.erase(edge->src());
+        }
+      }
+
+      cost.flops += opCost.flops;
+      cost.paramBytes += opCost.paramBytes;
+      cost.ops.push_back(opCost);
+    }
+
+    return cost;
+  }
+
+}  // namespace tensorflow
@@ -0,0 +1,617 @@
+/*
+ * Lightweight evaluator for small dense networks stored in constant graphs.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "PhysicsTools/TensorFlow/interface/NativeGraph.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+namespace tensorflow {
+
+  namespace {
+
+    typedef Eigen::Array<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowArray;
+    typedef Eigen::Map<RowArray> ArrayMap;
+    typedef Eigen::Map<const RowArray> ConstArrayMap;
+    typedef Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> MatrixMap;
+    typedef Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> ConstMatrixMap;
+    typedef Eigen::Map<const Eigen::Array<float, 1, Eigen::Dynamic>> ConstRowMap;
+
+    // strips the default output index ":0" from a tensor name
+    std::string canonicalName(const std::string& name) {
+      if (name.size() > 2 && name.compare(name.size() - 2, 2, ":0") == 0) {
+        return name.substr(0, name.size() - 2);
+      }
+      return name;
+    }
+
+    bool isControlInput(const std::string& name) { return !name.empty() && name[0] == '^'; }
+
+    bool isPassThrough(const std::string& op) { return op == "Identity" || op == "StopGradient" || op == "Snapshot"; }
+
+    // returns an attribute of a node
+    // throws a cms exception naming the node when the attribute is missing
+    const AttrValue& getAttr(const NodeDef& node, const std::string& name) {
+      auto it = node.attr().find(name);
+      if (it == node.attr().end()) {
+        throw cms::Exception("UnsupportedNativeGraph")
+            << "node '" << node.name() << "' has no attribute '" << name << "'";
+      }
+      return it->second;
+    }
+
+    // returns a boolean attribute of a node, or false when it is missing
+    bool getBoolAttr(const NodeDef& node, const std::string& name) {
+      auto it = node.attr().find(name);
+      return it != node.attr().end() && it->second.b();
+    }
+
+    // returns the data input at index of a node
+    // throws a cms exception naming the node when it has fewer data inputs
+    const std::string& getInput(const NodeDef& node, const std::vector<std::string>& inputNames, size_t index) {
+      if (index >= inputNames.size()) {
+        throw cms::Exception("UnsupportedNativeGraph")
+            << "node '" << node.name() << "' has " << inputNames.size() << " inputs, expected at least " << index + 1;
+      }
+      return inputNames[index];
+    }
+
+    // returns the known shape dimensions of a placeholder, or -2 as the first entry for unknown rank
+    std::vector<int64> placeholderShape(const NodeDef& node) {
+      auto it = node.attr().find("shape");
+      if (it == node.attr().end() || it->second.shape().unknown_rank()) {
+        return {-2};
+      }
+      std::vector<int64> dims;
+      for (const auto& dim : it->second.shape().dim()) {
+        dims.push_back(dim.size());
+      }
+      return dims;
+    }
+
+  }  // namespace
+
+  NativeGraph::NativeGraph(const GraphDef& graphDef, const std::vector<std::string>& outputNames) {
+    if (outputNames.empty()) {
+      throw cms::Exception("UnsupportedNativeGraph") << "no output names given";
+    }
+
+    // index nodes and count their consumers, which decides whether steps can be fused
+    // pass-through nodes alias their input, so their consumers are counted for the source instead
+    for (const NodeDef& node : graphDef.node()) {
+      nodes_[node.name()] = &node;
+    }
+    for (const NodeDef& node : graphDef.node()) {
+      if (isPassThrough(node.op())) {
+        continue;
+      }
+      for (const std::string& input : node.input()) {
+        if (!isControlInput(input)) {
+          nConsumers_[resolveAlias(input)]++;
+        }
+      }
+    }
+    for (const std::string& outputName : outputNames) {
+      nConsumers_[resolveAlias(outputName)]++;
+    }
+
+    // compile all outputs, which must be batched values
+    for (const std::string& outputName : outputNames) {
+      Operand operand = compileTensor(outputName);
+      if (operand.kind != OperandKind::Batch) {
+        throw cms::Exception("UnsupportedNativeGraph")
+            << "output '" << outputName << "' does not depend on batch inputs";
+      }
+      outputBuffers_[canonicalName(outputName)] = operand.index;
+    }
+
+    if (batchInputs_.empty()) {
+      throw cms::Exception("UnsupportedNativeGraph") << "graph has no batch inputs";
+    }
+
+    // clear compilation state
+    nodes_.clear();
+    nConsumers_.clear();
+    compiled_.clear();
+  }
+
+  bool NativeGraph::hasOutputs(const std::vector<std::string>& outputNames) const {
+    for (const std::string& outputName : outputNames) {
+      if (outputBuffers_.find(canonicalName(outputName)) == outputBuffers_.end()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  NativeGraph::Operand NativeGraph::compileTensor(const std::string& tensorName) {
+    std::string name = canonicalName(tensorName);
+
+    // check if already compiled
+    auto it = compiled_.find(name);
+    if (it != compiled_.end()) {
+      return it->second;
+    }
+
+    // only the first output of nodes is supported
+    if (name.find(':') != std::string::npos) {
+      throw cms::Exception("UnsupportedNativeGraph") << "tensor '" << tensorName << "' is not the first node output";
+    }
+    auto nodeIt = nodes_.find(name);
+    if (nodeIt == nodes_.end()) {
+      throw cms::Exception("UnsupportedNativeGraph") << "node '" << name << "' not found in graph";
+    }
+    if (std::find(compiling_.begin(), compiling_.end(), name) != compiling_.end()) {
+      throw cms::Exception("UnsupportedNativeGraph") << "graph contains a cycle at node '" << name << "'";
+    }
+
+    compiling_.push_back(name);
+    Operand operand = compileNode(*nodeIt->second);
+    compiling_.pop_back();
+
+    compiled_[name] = operand;
+    return operand;
+  }
+
+  NativeGraph::Operand NativeGraph::compileNode(const NodeDef& node) {
+    const std::string& op = node.op();
+
+    // collect data inputs
+    std::vector<std::string> inputNames;
+    for (const std::string& input : node.input()) {
+      if (!isControlInput(input)) {
+        inputNames.push_back(input);
+      }
+    }
+
+    if (op == "Placeholder") {
+      auto dtype = node.attr().find("dtype");
+      if (dtype == node.attr().end() || dtype->second.type() != DT_FLOAT) {
+        throw cms::Exception("UnsupportedNativeGraph") << "placeholder '" << node.name() << "' is not of type float";
+      }
+      std::vector<int64> shape = placeholderShape(node);
+      if (shape.size() == 2) {
+        if (shape[1] <= 0) {
+          throw cms::Exception("UnsupportedNativeGraph")
+              << "placeholder '" << node.name() << "' has an unknown number of features";
+        }
+        batchInputs_.push_back(node.name());
+        return addBuffer(shape[1], batchInputs_.size() - 1);
+      }
+      if (shape.size() <= 1) {
+        broadcastInputs_.push_back(node.name());
+        return {OperandKind::Broadcast, int(broadcastInputs_.size()) - 1};
+      }
+      throw cms::Exception("UnsupportedNativeGraph") << "placeholder '" << node.name() << "' has rank " << shape.size();
+    }
+
+    if (op == "Const") {
+      Tensor tensor;
+      if (!tensor.FromProto(getAttr(node, "value").tensor())) {
+        throw cms::Exception("UnsupportedNativeGraph") << "cannot parse constant '" << node.name() << "'";
+      }
+      return {OperandKind::Constant, addConstant(tensor, node.name())};
+    }
+
+    if (isPassThrough(op)) {
+      return compileTensor(getInput(node, inputNames, 0));
+    }
+
+    if (op == "MatMul") {
+      if (getBoolAttr(node, "transpose_a")) {
+        throw cms::Exception("UnsupportedNativeGraph") << "MatMul '" << node.name() << "' transposes its input";
+      }
+      Operand input = compileTensor(getInput(node, inputNames, 0));
+      if (input.kind != OperandKind::Batch) {
+        throw cms::Exception("UnsupportedNativeGraph") << "MatMul '" << node.name() << "' has no batch input";
+      }
+
+      // weights must be constant
+      Tensor tensor;
+      if (!findConstant(getInput(node, inputNames, 1), &tensor)) {
+        throw cms::Exception("UnsupportedNativeGraph") << "MatMul '" << node.name() << "' has non-constant weights";
+      }
+      if (tensor.dtype() != DT_FLOAT || tensor.dims() != 2) {
+        throw cms::Exception("UnsupportedNativeGraph") << "MatMul '" << node.name() << "' has invalid weights";
+      }
+
+      // store weights column-major so that the weights of each output are contiguous
+      ConstMatrixMap w(tensor.flat<float>().data(), tensor.dim_size(0), tensor.dim_size(1));
+      bool transposeB = getBoolAttr(node, "transpose_b");
+      if (transposeB) {
+        weights_.push_back(w.transpose());
+      } else {
+        weights_.push_back(w);
+      }
+      if (weights_.back().rows() != width(input)) {
+        throw cms::Exception("UnsupportedNativeGraph")
+            << "MatMul '" << node.name() << "' expects " << weights_.back().rows() << " inputs, got " << width(input);
+      }
+
+      Operand output = addBuffer(weights_.back().cols());
+      steps_.push_back(
+          {StepType::Dense, output.index, {input}, int(weights_.size()) - 1, -1, 0, false, Activation::None});
+      return output;
+    }
+
+    if (op == "BiasAdd" || op == "Add" || op == "AddV2" || op == "Sub" || op == "Mul") {
+      char binaryOp = op == "Sub" ? '-' : (op == "Mul" ? '*' : '+');
+      std::string aName = canonicalName(getInput(node, inputNames, 0));
+      Operand a = compileTensor(aName);
+      Operand b = compileTensor(getInput(node, inputNames, 1));
+
+      // bring the batch operand to the front
+      bool reversed = false;
+      if (a.kind != OperandKind::Batch) {
+        if (b.kind != OperandKind::Batch) {
+          throw cms::Exception("UnsupportedNativeGraph") << op << " '" << node.name() << "' has no batch input";
+        }
+        std::swap(a, b);
+        aName = canonicalName(inputNames[1]);
+        reversed = binaryOp == '-';
+      }
+
+      // check widths
+      int w = width(a);
+      if (b.kind != OperandKind::Broadcast && width(b) != w && !(b.kind == OperandKind::Constant && width(b) == 1)) {
+        throw cms::Exception("UnsupportedNativeGraph")
+            << op << " '" << node.name() << "' has incompatible widths " << w << " and " << width(b);
+      }
+
+      // fuse a constant bias into a preceding dense step
+      if (binaryOp == '+' && b.kind == OperandKind::Constant && fusable(a)) {
+        Step& step = steps_.back();
+        if (step.type == StepType::Dense && step.bias < 0 && step.activation == Activation::None) {
+          nConsumers_[resolveAlias(aName)]--;
+          if (constants_[b.index].size() == 1) {
+            constants_.push_back(ConstantRow::Constant(w, constants_[b.index](0)));
+            b.index = constants_.size() - 1;
+          }
+          step.bias = b.index;
+          return a;
+        }
+      }
+
+      Operand output = addBuffer(w);
+      steps_.push_back({StepType::Binary, output.index, {a, b}, -1, -1, binaryOp, reversed, Activation::None});
+      return output;
+    }
+
+    if (op == "Relu" || op == "Relu6" || op == "Elu" || op == "Sigmoid" || op == "Tanh" || op == "Softmax") {
+      Activation activation = op == "Relu"      ? Activation::Relu
+                              : op == "Relu6"   ? Activation::Relu6
+                              : op == "Elu"     ? Activation::Elu
+                              : op == "Sigmoid" ? Activation::Sigmoid
+                              : op == "Tanh"    ? Activation::Tanh
+                                                : Activation::Softmax;
+      std::string inputName = canonicalName(getInput(node, inputNames, 0));
+      Operand input = compileTensor(inputName);
+      if (input.kind != OperandKind::Batch) {
+        throw cms::Exception("UnsupportedNativeGraph") << op << " '" << node.name() << "' has no batch input";
+      }
+
+      // fuse into the preceding step
+      if (fusable(input) && steps_.back().activation == Activation::None) {
+        nConsumers_[resolveAlias(inputName)]--;
+        steps_.back().activation = activation;
+        return input;
+      }
+
+      Operand output = addBuffer(width(input));
+      steps_.push_back({StepType::Activation, output.index, {input}, -1, -1, 0, false, activation});
+      return output;
+    }
+
+    if (op == "ConcatV2") {
+      // the last input is the axis which must be the feature axis
+      if (inputNames.size() < 2) {
+        throw cms::Exception("UnsupportedNativeGraph")
+            << "ConcatV2 '" << node.name() << "' has no inputs to concatenate";
+      }
+      Tensor axis;
+      if (!findConstant(inputNames.back(), &axis) || axis.dtype() != DT_INT32 || axis.NumElements() != 1 ||
+          (axis.flat<int32>()(0) != 1 && axis.flat<int32>()(0) != -1)) {
+        throw cms::Exception("UnsupportedNativeGraph") << "ConcatV2 '" << node.name() << "' is not along axis 1";
+      }
+
+      std::vector<Operand> inputs;
+      int w = 0;
+      for (size_t i = 0; i < inputNames.size() - 1; i++) {
+        inputs.push_back(compileTensor(inputNames[i]));
+        if (inputs.back().kind != OperandKind::Batch) {
+          throw cms::Exception("UnsupportedNativeGraph") << "ConcatV2 '" << node.name() << "' has non-batch inputs";
+        }
+        w += width(inputs.back());
+      }
+
+      Operand output = addBuffer(w);
+      steps_.push_back({StepType::Concat, output.index, inputs, -1, -1, 0, false, Activation::None});
+      return output;
+    }
+
+    throw cms::Exception("UnsupportedNativeGraph") << "op '" << op << "' of node '" << node.name() << "' not supported";
+  }
+
+  bool NativeGraph::findConstant(const std::string& tensorName, Tensor* tensor) const {
+    // follow identities, e.g. "<variable>/read" nodes that remain after freezing variables
+    std::string name = canonicalName(tensorName);
+    while (true) {
+      auto it = nodes_.find(name);
+      if (it == nodes_.end()) {
+        return false;
+      }
+      const NodeDef& node = *it->second;
+      if (node.op() == "Identity" && node.input_size() > 0) {
+        name = canonicalName(node.input(0));
+      } else {
+        auto value = node.attr().find("value");
+        return node.op() == "Const" && value != node.attr().end() && tensor->FromProto(value->second.tensor());
+      }
+    }
+  }
+
+  std::string NativeGraph::resolveAlias(const std::string& tensorName) const {
+    std::string name = canonicalName(tensorName);
+    while (true) {
+      auto it = nodes_.find(name);
+      if (it == nodes_.end() || !isPassThrough(it->second->op()) || it->second->input_size() == 0 ||
+          isControlInput(it->second->input(0))) {
+        return name;
+      }
+      name = canonicalName(it->second->input(0));
+    }
+  }
+
+  NativeGraph::Operand NativeGraph::addBuffer(int width, int batchInput) {
+    bufferWidths_.push_back(width);
+    bufferInputs_.push_back(batchInput);
+    return {OperandKind::Batch, int(bufferWidths_.size()) - 1};
+  }
+
+  int NativeGraph::addConstant(const Tensor& tensor, const std::string& nodeName) {
+    // only scalars and row vectors are supported as constant operands
+    if (tensor.dtype() != DT_FLOAT || tensor.dims() > 2 || (tensor.dims() == 2 && tensor.dim_size(0) != 1)) {
+      throw cms::Exception("UnsupportedNativeGraph")
+          << "constant '" << nodeName << "' is not a float scalar or row vector";
+    }
+    constants_.push_back(ConstRowMap(tensor.flat<float>().data(), tensor.NumElements()));
+    return constants_.size() - 1;
+  }
+
+  int NativeGraph::width(const Operand& operand) const {
+    switch (operand.kind) {
+      case OperandKind::Batch:
+        return bufferWidths_[operand.index];
+      case OperandKind::Constant:
+        return constants_[operand.index].size();
+      default:
+        return -1;
+    }
+  }
+
+  bool NativeGraph::fusable(const Operand& operand) const {
+    // the operand must be the output of the last step, with the node being compiled as its only
+    // consumer, considering all nodes that alias the same buffer, i.e., fused nodes, while
+    // consumers of pass-through nodes are already counted for their source
+    if (operand.kind != OperandKind::Batch || steps_.empty() || steps_.back().output != operand.index) {
+      return false;
+    }
+    int nConsumers = 0;
+    for (const auto& it : compiled_) {
+      if (it.second.kind == OperandKind::Batch && it.second.index == operand.index) {
+        auto count = nConsumers_.find(it.first);
+        nConsumers += count == nConsumers_.end() ? 0 : count->second;
+      }
+    }
+    return nConsumers == 1;
+  }
+
+  void NativeGraph::run(const NamedTensorList& inputs,
+                        const std::vector<std::string>& outputNames,
+                        std::vector<Tensor>* outputs) const {
+    if (!hasOutputs(outputNames)) {
+      throw cms::Exception("InvalidRun") << "native graph does not provide all requested outputs";
+    }
+
+    // lookup inputs
+    auto findInput = [&inputs](const std::string& name) -> const Tensor& {
+      for (const NamedTensor& input : inputs) {
+        if (canonicalName(input.first) == name) {
+          return input.second;
+        }
+      }
+      throw cms::Exception("InvalidRun") << "missing input '" << name << "' for native graph";
+    };
+
+    int64 batchSize = -1;
+    std::vector<const float*> batchData;
+    for (const std::string& name : batchInputs_) {
+      const Tensor& tensor = findInput(name);
+      if (tensor.dtype() != DT_FLOAT || tensor.dims() != 2 || (batchSize >= 0 && tensor.dim_size(0) != batchSize)) {
+        throw cms::Exception("InvalidRun") << "input '" << name << "' must be a float tensor of shape {batch, n}";
+      }
+      batchSize = tensor.dim_size(0);
+      batchData.push_back(tensor.flat<float>().data());
+    }
+
+    std::vector<ConstRowMap> broadcastData;
+    for (const std::string& name : broadcastInputs_) {
+      const Tensor& tensor = findInput(name);
+      if (tensor.dtype() != DT_FLOAT) {
+        throw cms::Exception("InvalidRun") << "input '" << name << "' must be a float tensor";
+      }
+      // values are broadcasted row-wise, so per-row values such as {batch, 1} must be rejected
+      if (tensor.dims() > 2 || (tensor.dims() == 2 && tensor.dim_size(0) != 1)) {
+        throw cms::Exception("InvalidRun") << "input '" << name << "' of shape " << tensor.shape().DebugString()
+                                           << " cannot be broadcasted row-wise, expected a scalar or {1, n}";
+      }
+      broadcastData.emplace_back(tensor.flat<float>().data(), tensor.NumElements());
+    }
+
+    // assign memory of all buffers, using a single allocation for intermediate results
+    size_t nBuffers = bufferWidths_.size();
+    std::vector<size_t> offsets(nBuffers, 0);
+    size_t nValues = 0;
+    for (size_t i = 0; i < nBuffers; i++) {
+      if (bufferInputs_[i] < 0) {
+        offsets[i] = nValues;
+        nValues += batchSize * bufferWidths_[i];
+      }
+    }
+    std::vector<float> storage(nValues);
+    auto data = [&](int i) -> float* {
+      return bufferInputs_[i] >= 0 ? const_cast<float*>(batchData[bufferInputs_[i]]) : storage.data() + offsets[i];
+    };
+
+    // returns the row-wise operand of binary steps
+    auto rowOperand = [&](const Operand& operand) -> ConstRowMap {
+      if (operand.kind == OperandKind::Constant) {
+        return ConstRowMap(constants_[operand.index].data(), constants_[operand.index].size());
+      }
+      return broadcastData[operand.index];
+    };
+
+    for (const Step& step : steps_) {
+      int w = bufferWidths_[step.output];
+      ArrayMap out(data(step.output), batchSize, w);
+
+      if (step.type == StepType::Dense) {
+        const Operand& input = step.inputs[0];
+        ConstMatrixMap in(data(input.index), batchSize, bufferWidths_[input.index]);
+        MatrixMap(data(step.output), batchSize, w).noalias() = in * weights_[step.weights];
+        if (step.bias >= 0) {
+          out.rowwise() += constants_[step.bias];
+        }
+
+      } else if (step.type == StepType::Binary) {
+        ConstArrayMap a(data(step.inputs[0].index), batchSize, w);
+        const Operand& b = step.inputs[1];
+        if (step.reversed) {
+          out = -a;
+        } else {
+          out = a;
+        }
+        char binaryOp = step.reversed ? '+' : step.binaryOp;
+
+        if (b.kind == OperandKind::Batch) {
+          ConstArrayMap bArr(data(b.index), batchSize, w);
+          if (binaryOp == '+') {
+            out += bArr;
+          } else if (binaryOp == '-') {
+            out -= bArr;
+          } else {
+            out *= bArr;
+          }
+        } else {
+          ConstRowMap row = rowOperand(b);
+          if (row.size() != 1 && row.size() != w) {
+            throw cms::Exception("InvalidRun")
+                << "broadcasted operand has " << row.size() << " values, but 1 or " << w << " are expected";
+          }
+          if (row.size() == 1) {
+            if (binaryOp == '+') {
+              out += row(0);
+            } else if (binaryOp == '-') {
+              out -= row(0);
+            } else {
+              out *= row(0);
+            }
+          } else {
+            if (binaryOp == '+') {
+              out.rowwise() += row;
+            } else if (binaryOp == '-') {
+              out.rowwise() -= row;
+            } else {
+              out.rowwise() *= row;
+            }
+          }
+        }
+
+      } else if (step.type == StepType::Activation) {
+        out = ConstArrayMap(data(step.inputs[0].index), batchSize, w);
+
+      } else if (step.type == StepType::Concat) {
+        int offset = 0;
+        for (const Operand& input : step.inputs) {
+          int inputWidth = bufferWidths_[input.index];
+          out.block(0, offset, batchSize, inputWidth) = ConstArrayMap(data(input.index), batchSize, inputWidth);
+          offset += inputWidth;
+        }
+      }
+
+      // apply the activation in-place
+      switch (step.activation) {
+        case Activation::Relu:
+          out = out.max(0.f);
+          break;
+        case Activation::Relu6:
+          out = out.max(0.f).min(6.f);
+          break;
+        case Activation::Elu:
+          out = (out > 0.f).select(out, out.exp() - 1.f);
+          break;
+        case Activation::Sigmoid:
+          out = (1.f + (-out).exp()).inverse();
+          break;
+        case Activation::Tanh:
+          out = out.tanh();
+          break;
+        case Activation::Softmax: {
+          Eigen::Array<float, Eigen::Dynamic, 1> rowMax = out.rowwise().maxCoeff();
+          out.colwise() -= rowMax;
+          out = out.exp();
+          Eigen::Array<float, Eigen::Dynamic, 1> rowSum = out.rowwise().sum();
+          out.colwise() /= rowSum;
+          break;
+        }
+        default:
+          break;
+      }
+    }
+
+    // copy outputs
+    outputs->clear();
+    for (const std::string& outputName : outputNames) {
+      // all outputs exist as checked by hasOutputs()
+      int index = outputBuffers_.find(canonicalName(outputName))->second;
+      Tensor output(DT_FLOAT, {batchSize, bufferWidths_[index]});
+      std::memcpy(output.flat<float>().data(), data(index), batchSize * bufferWidths_[index] * sizeof(float));
+      outputs->push_back(output);
+    }
+  }
+
+  NativeGraph* createNativeGraph(const GraphDef* graphDef, const std::vector<std::string>& outputNames) {
+    // check for valid pointer
+    if (graphDef == nullptr) {
+      throw cms::Exception("InvalidGraphDef") << "error while creating native graph: graphDef is nullptr";
+    }
+
+    try {
+      return new NativeGraph(*graphDef, outputNames);
+    } catch (cms::Exception& e) {
+      edm::LogInfo("PhysicsTools/TensorFlow") << "graph cannot be evaluated natively: " << e.explainSelf();
+      return nullptr;
+    }
+  }
+
+  void run(const NativeGraph* nativeGraph,
+           Session* session,
+           const NamedTensorList& inputs,
+           const std::vector<std::string>& outputNames,
+           std::vector<Tensor>* outputs,
+           const std::string& threadPoolName) {
+    if (nativeGraph != nullptr && nativeGraph->hasOutputs(outputNames)) {
+      nativeGraph->run(inputs, outputNames, outputs);
+    } else {
+      run(session, inputs, outputNames, outputs, threadPoolName);
+    }
+  }
+
+}  // namespace tensorflow
@@ -0,0 +1,203 @@
+/*
+ * Capturing of inputs, output names and timings of session runs to a compact binary file, and
+ * reading them back for offline replay.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include "PhysicsTools/TensorFlow/interface/RunCapture.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
+
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/io/compression.h"
+
+namespace tensorflow {
+
+  namespace {
+
+    // version of the record layout, written as the first field of each record
+    const uint64 kRecordVersion = 1;
+
+    const char* kCompression = io::compression::kZlib;
+
+    bool getString(StringPiece* input, std::string* value) {
+      StringPiece piece;
+      if (!core::GetLengthPrefixedSlice(input, &piece)) {
+        return false;
+      }
+      *value = std::string(piece);
+      return true;
+    }
+
+  }  // namespace
+
+  RunCapture::~RunCapture() {
+    try {
+      stop();
+    } catch (std::exception& e) {
+      edm::LogWarning("PhysicsTools/TensorFlow") << "error while stopping run capture: " << e.what();
+    }
+  }
+
+  void RunCapture::start(const std::string& path, int64 sampleInterval, const Session* session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_) {
+      throw cms::Exception("InvalidRunCapture") << "cannot start capture to " << path << ", capture already active";
+    }
+
+    Status status = Env::Default()->NewWritableFile(path, &file_);
+    if (!status.ok()) {
+      throw cms::Exception("InvalidRunCapture") << "error while opening capture file " << path << ": "
+                                                << status.ToString();
+    }
+    writer_.reset(new io::RecordWriter(file_.get(), io::RecordWriterOptions::CreateRecordWriterOptions(kCompression)));
+
+    sampleInterval_ = sampleInterval > 0 ? sampleInterval : 1;
+    session_ = session;
+    nCalls_ = 0;
+    nRecorded_ = 0;
+    active_ = true;
+  }
+
+  void RunCapture::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_) {
+      return;
+    }
+    active_ = false;
+
+    // closing the writer flushes the compression buffers
+    Status status = writer_->Close();
+    if (status.ok()) {
+      status = file_->Close();
+    }
+    writer_.reset();
+    file_.reset();
+    if (!status.ok()) {
+      throw cms::Exception("InvalidRunCapture") << "error while closing capture file: " << status.ToString();
+    }
+  }
+
+  void RunCapture::setSessionName(const Session* session, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessionNames_[session] = name;
+  }
+
+  bool RunCapture::sample(const Session* session) {
+    const Session* capturedSession = session_;
+    if (!active_ || (capturedSession != nullptr && session != capturedSession)) {
+      return false;
+    }
+    return nCalls_++ % sampleInterval_ == 0;
+  }
+
+  void RunCapture::record(const Session* session,
+                          const std::vector<std::pair<std::string, Tensor>>& inputs,
+                          const std::vector<std::string>& outputNames,
+                          int64 durationNs) {
+    // serialize outside the lock, tensors are stored with their content in a single bytes field
+    std::string record;
+    core::PutVarint64(&record, kRecordVersion);
+    core::PutVarint64(&record, uint64(durationNs));
+    core::PutVarint64(&record, inputs.size());
+    for (const auto& input : inputs) {
+      TensorProto proto;
+      input.second.AsProtoTensorContent(&proto);
+      core::PutLengthPrefixedSlice(&record, input.first);
+      core::PutLengthPrefixedSlice(&record, proto.SerializeAsString());
+    }
+    core::PutVarint64(&record, outputNames.size());
+    for (const std::string& outputName : outputNames) {
+      core::PutLengthPrefixedSlice(&record, outputName);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_) {
+      return;
+    }
+
+    // prepend the session name, assigning a default one on first sight
+    auto it = sessionNames_.find(session);
+    if (it == sessionNames_.end()) {
+      it = sessionNames_.emplace(session, "session_" + std::to_string(sessionNames_.size())).first;
+    }
+    std::string nameField;
+    core::PutLengthPrefixedSlice(&nameField, it->second);
+
+    // the run itself succeeded, so a failing capture is disabled rather than failing the run
+    Status status = writer_->WriteRecord(nameField + record);
+    if (!status.ok()) {
+      edm::LogWarning("PhysicsTools/TensorFlow")
+          << "error while writing capture record, stopping capture: " << status.ToString();
+      active_ = false;
+      writer_->Close().IgnoreError();
+      file_->Close().IgnoreError();
+      writer_.reset();
+      file_.reset();
+      return;
+    }
+    nRecorded_++;
+  }
+
+  RunCaptureReader::RunCaptureReader(const std::string& path) : path_(path) {
+    Status status = Env::Default()->NewRandomAccessFile(path, &file_);
+    if (!status.ok()) {
+      throw cms::Exception("InvalidRunCapture") << "error while opening capture file " << path << ": "
+                                                << status.ToString();
+    }
+    reader_.reset(
+        new io::SequentialRecordReader(file_.get(), io::RecordReaderOptions::CreateRecordReaderOptions(kCompression)));
+  }
+
+  bool RunCaptureReader::next(CapturedRun* capturedRun) {
+    tstring record;
+    Status status = reader_->ReadRecord(&record);
+    if (errors::IsOutOfRange(status)) {
+      return false;
+    }
+    if (!status.ok()) {
+      throw cms::Exception("InvalidRunCapture") << "error while reading capture file " << path_ << ": "
+                                                << status.ToString();
+    }
+
+    // parse the fields in the order they were written
+    StringPiece input(record);
+    uint64 version = 0, duration = 0, nInputs = 0, nOutputs = 0;
+    bool ok = getString(&input, &capturedRun->sessionName) && core::GetVarint64(&input, &version) &&
+              version == kRecordVersion && core::GetVarint64(&input, &duration) &&
+              core::GetVarint64(&input, &nInputs);
+    capturedRun->durationNs = int64(duration);
+    capturedRun->inputs.clear();
+    for (uint64 i = 0; ok && i < nInputs; i++) {
+      std::string name, protoBytes;
+      TensorProto proto;
+      Tensor tensor;
+      ok = getString(&input, &name) && getString(&input, &protoBytes) && proto.ParseFromString(protoBytes) &&
+           tensor.FromProto(proto);
+      if (ok) {
+        capturedRun->inputs.emplace_back(name, tensor);
+      }
+    }
+    ok = ok && core::GetVarint64(&input, &nOutputs);
+    capturedRun->outputNames.clear();
+    for (uint64 i = 0; ok && i < nOutputs; i++) {
+      std::string name;
+      ok = getString(&input, &name);
+      if (ok) {
+        capturedRun->outputNames.push_back(name);
+      }
+    }
+    if (!ok || !input.empty()) {
+      edm::LogWarning("PhysicsTools/TensorFlow") << "corrupted record in capture file " << path_;
+      return false;
+    }
+
+    return true;
+  }
+
+}  // namespace tensorflow
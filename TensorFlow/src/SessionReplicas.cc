@@ -0,0 +1,299 @@
+/*
+ * NUMA-aware session replicas.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <dirent.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "tbb/task_group.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/task_scheduler_observer.h"
+
+#include "PhysicsTools/TensorFlow/interface/SessionReplicas.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+namespace tensorflow {
+
+  namespace {
+
+    // parses a cpu list such as "0-3,8,10-11"
+    std::vector<int> parseCPUList(const std::string& cpuList) {
+      std::vector<int> cpus;
+      std::stringstream ss(cpuList);
+      std::string range;
+      while (std::getline(ss, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+          int first = std::stoi(range.substr(0, dash));
+          int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+          for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+          }
+        } catch (std::exception&) {
+          // skip malformed entries such as trailing newlines
+        }
+      }
+      return cpus;
+    }
+
+    cpu_set_t cpuSet(const std::vector<int>& cpus) {
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      for (int cpu : cpus) {
+        CPU_SET(cpu, &mask);
+      }
+      return mask;
+    }
+
+    // replicas use their own inter-op thread pool, as the process-global pool would be spawned by
+    // the first replica and inherit its affinity
+    SessionOptions replicaSessionOptions(int nThreads) {
+      SessionOptions sessionOptions;
+      setThreading(sessionOptions, nThreads);
+      sessionOptions.config.set_use_per_session_threads(true);
+      return sessionOptions;
+    }
+
+  }  // namespace
+
+  std::vector<std::vector<int>> numaNodeCPUs() {
+    // cpus the process is allowed to run on
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      CPU_ZERO(&allowed);
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        CPU_SET(cpu, &allowed);
+      }
+    }
+
+    // find nodes
+    std::vector<int> nodeIds;
+    const std::string nodeDir = "/sys/devices/system/node";
+    if (DIR* dir = opendir(nodeDir.c_str())) {
+      while (struct dirent* entry = readdir(dir)) {
+        std::string name(entry->d_name);
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            name.find_first_not_of("0123456789", 4) == std::string::npos) {
+          nodeIds.push_back(std::stoi(name.substr(4)));
+        }
+      }
+      closedir(dir);
+    }
+    std::sort(nodeIds.begin(), nodeIds.end());
+
+    // read allowed cpus per node
+    std::vector<std::vector<int>> nodes;
+    for (int nodeId : nodeIds) {
+      std::ifstream file(nodeDir + "/node" + std::to_string(nodeId) + "/cpulist");
+      std::string cpuList;
+      std::getline(file, cpuList);
+      std::vector<int> cpus;
+      for (int cpu : parseCPUList(cpuList)) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+          cpus.push_back(cpu);
+        }
+      }
+      if (!cpus.empty()) {
+        nodes.push_back(cpus);
+      }
+    }
+
+    // fallback to a single node
+    if (nodes.empty()) {
+      std::vector<int> cpus;
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+          cpus.push_back(cpu);
+        }
+      }
+      nodes.push_back(cpus);
+    }
+
+    return nodes;
+  }
+
+  // observer that pins threads to the cpus while they work in the observed arena and restores
+  // their previous affinity when they leave it
+  class PinnedTBBThreadPool::Pinner : public tbb::task_scheduler_observer {
+  public:
+    Pinner(tbb::task_arena& taskArena, const std::vector<int>& cpus)
+        : tbb::task_scheduler_observer(taskArena), mask_(cpuSet(cpus)) {
+      observe(true);
+    }
+
+    ~Pinner() override { observe(false); }
+
+    void on_scheduler_entry(bool) override {
+      cpu_set_t previous;
+      if (sched_getaffinity(0, sizeof(previous), &previous) == 0 &&
+          sched_setaffinity(0, sizeof(mask_), &mask_) == 0) {
+        previousMasks().push_back(previous);
+      }
+    }
+
+    void on_scheduler_exit(bool) override {
+      std::vector<cpu_set_t>& masks = previousMasks();
+      if (!masks.empty()) {
+        sched_setaffinity(0, sizeof(masks.back()), &masks.back());
+        masks.pop_back();
+      }
+    }
+
+  private:
+    // stack of masks per thread to support nested arenas
+    static std::vector<cpu_set_t>& previousMasks() {
+      thread_local std::vector<cpu_set_t> masks;
+      return masks;
+    }
+
+    const cpu_set_t mask_;
+  };
+
+  PinnedTBBThreadPool::PinnedTBBThreadPool(const std::vector<int>& cpus, int nThreads)
+      : nThreads_(nThreads > 0 ? nThreads
+                               : (cpus.empty() ? tbb::task_scheduler_init::default_num_threads() : int(cpus.size()))),
+        taskArena_(nThreads_),
+        numScheduleCalled_(0) {
+    taskArena_.initialize();
+    if (!cpus.empty()) {
+      pinner_.reset(new Pinner(taskArena_, cpus));
+    }
+  }
+
+  PinnedTBBThreadPool::~PinnedTBBThreadPool() {
+    // stop observing before the arena is destroyed
+    pinner_.reset();
+  }
+
+  void PinnedTBBThreadPool::Schedule(std::function<void()> fn) {
+    numScheduleCalled_ += 1;
+
+    tbb::task_group taskGroup;
+
+    // we are required to always call wait before destructor
+    auto doneWithTaskGroup = [this, &taskGroup](void*) { taskArena_.execute([&taskGroup]() { taskGroup.wait(); }); };
+    std::unique_ptr<tbb::task_group, decltype(doneWithTaskGroup)> taskGuard(&taskGroup, doneWithTaskGroup);
+
+    // schedule the task
+    taskArena_.execute([&taskGroup, &fn] { taskGroup.run(fn); });
+
+    // reset the task guard which will call wait
+    taskGuard.reset();
+  }
+
+  int PinnedTBBThreadPool::CurrentThreadId() const {
+    int id = tbb::this_task_arena::current_thread_index();
+    return (id >= 0 && id < nThreads_) ? id : -1;
+  }
+
+  SessionReplicas::SessionReplicas(GraphDef* graphDef, int nThreads, bool numaAware) {
+    createReplicas(
+        [graphDef, nThreads]() {
+          SessionOptions sessionOptions = replicaSessionOptions(nThreads);
+          return tensorflow::createSession(graphDef, sessionOptions);
+        },
+        numaAware);
+  }
+
+  SessionReplicas::SessionReplicas(MetaGraphDef* metaGraphDef,
+                                   const std::string& exportDir,
+                                   int nThreads,
+                                   bool numaAware) {
+    createReplicas(
+        [metaGraphDef, &exportDir, nThreads]() {
+          SessionOptions sessionOptions = replicaSessionOptions(nThreads);
+          return tensorflow::createSession(metaGraphDef, exportDir, sessionOptions);
+        },
+        numaAware);
+  }
+
+  SessionReplicas::~SessionReplicas() {
+    for (Replica& replica : replicas_) {
+      closeSession(replica.session);
+    }
+  }
+
+  void SessionReplicas::createReplicas(const std::function<Session*()>& create, bool numaAware) {
+    std::vector<std::vector<int>> nodes;
+    if (numaAware) {
+      nodes = numaNodeCPUs();
+    }
+
+    // single replica without pinning
+    if (nodes.size() <= 1) {
+      replicas_.push_back({{}, create(), nullptr});
+      return;
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+      const std::vector<int>& cpus = nodes[i];
+
+      // create the session in a thread pinned to the node so that memory allocated during creation
+      // (e.g. restored variables) and threads spawned by the session are local to it
+      Session* session = nullptr;
+      std::exception_ptr error;
+      std::thread thread([&cpus, &create, &session, &error]() {
+        try {
+          cpu_set_t mask = cpuSet(cpus);
+          sched_setaffinity(0, sizeof(mask), &mask);
+          session = create();
+        } catch (...) {
+          error = std::current_exception();
+        }
+      });
+      thread.join();
+
+      if (error) {
+        for (Replica& replica : replicas_) {
+          closeSession(replica.session);
+        }
+        replicas_.clear();
+        std::rethrow_exception(error);
+      }
+
+      replicas_.push_back({cpus, session, std::unique_ptr<PinnedTBBThreadPool>(new PinnedTBBThreadPool(cpus))});
+
+      // map cpus to replicas
+      for (int cpu : cpus) {
+        if (size_t(cpu) >= cpuReplicas_.size()) {
+          cpuReplicas_.resize(cpu + 1, 0);
+        }
+        cpuReplicas_[cpu] = i;
+      }
+    }
+
+    edm::LogInfo("PhysicsTools/TensorFlow") << "created " << replicas_.size() << " NUMA-local session replicas";
+  }
+
+  size_t SessionReplicas::localReplica() const {
+    if (replicas_.size() == 1) {
+      return 0;
+    }
+    int cpu = sched_getcpu();
+    return (cpu >= 0 && size_t(cpu) < cpuReplicas_.size()) ? cpuReplicas_[cpu] : 0;
+  }
+
+  void SessionReplicas::run(const NamedTensorList& inputs,
+                            const std::vector<std::string>& outputNames,
+                            std::vector<Tensor>* outputs,
+                            const std::string& threadPoolName) const {
+    const Replica& replica = replicas_[localReplica()];
+    if (threadPoolName == "tbb" && replica.threadPool) {
+      tensorflow::run(replica.session, inputs, outputNames, outputs, replica.threadPool.get());
+    } else {
+      tensorflow::run(replica.session, inputs, outputNames, outputs, threadPoolName);
+    }
+  }
+
+}  // namespace tensorflow
@@ -6,12 +6,432 @@
  * Author: Marcel Rieger
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+
 #include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
 
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
 
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/protobuf/saved_model.pb.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+#include "zlib.h"
+#include "zstd.h"
+
 namespace tensorflow {
 
+  namespace {
+
+    // registers a session at the memory tracker when enabled, and closes it when the budget would be
+    // exceeded before rethrowing the exception
+    void trackSession(Session*& session, const GraphDef& graphDef) {
+      MemoryTracker& tracker = MemoryTracker::instance();
+      if (!tracker.enabled()) {
+        return;
+      }
+      try {
+        tracker.registerSession(session, estimateWeightBytes(graphDef));
+      } catch (cms::Exception&) {
+        closeSession(session);
+        throw;
+      }
+    }
+
+    // checks metaGraphDef and returns a new session containing its graph
+    Session* createMetaGraphSession(MetaGraphDef* metaGraphDef, SessionOptions& sessionOptions) {
+      // check for valid pointer
+      if (metaGraphDef == nullptr) {
+        throw cms::Exception("InvalidMetaGraphDef") << "error while creating session: metaGraphDef is nullptr";
+      }
+
+      // check that the graph has nodes
+      if (metaGraphDef->graph_def().node_size() <= 0) {
+        throw cms::Exception("InvalidMetaGraphDef") << "error while creating session: graphDef has no nodes";
+      }
+
+      Session* session = createSession(sessionOptions);
+      trackSession(session, metaGraphDef->graph_def());
+
+      // add the graph def from the meta graph, closing the session on failure to stop tracking it
+      Status status;
+      status = session->Create(metaGraphDef->graph_def());
+      if (!status.ok()) {
+        closeSession(session);
+        throw cms::Exception("InvalidMetaGraphDef")
+            << "error while attaching metaGraphDef to session: " << status.ToString();
+      }
+
+      return session;
+    }
+
+    // returns the prefix of the variable files in the export directory
+    std::string variablesFile(const std::string& exportDir) {
+      return io::JoinPath(exportDir, kSavedModelVariablesDirectory, kSavedModelVariablesFilename);
+    }
+
+    // restores all variables by running the restore op of the saver
+    void restoreAllVariables(Session* session, const MetaGraphDef& metaGraphDef, const std::string& varFile) {
+      // create a tensor to store the variable file
+      Tensor varFileTensor(DT_STRING, TensorShape({}));
+      varFileTensor.scalar<std::string>()() = varFile;
+
+      // run the restore op
+      Status status = session->Run({{metaGraphDef.saver_def().filename_tensor_name(), varFileTensor}},
+                                   {},
+                                   {metaGraphDef.saver_def().restore_op_name()},
+                                   nullptr);
+      if (!status.ok()) {
+        throw cms::Exception("InvalidSession") << "error while restoring variables in session: " << status.ToString();
+      }
+    }
+
+    // restores only the variables reachable from outputNames by reading their values from the
+    // checkpoint and feeding them to the assign ops of the saver, which are found by following
+    // their values back to the tensor names of the RestoreV2 ops
+    // returns false when a reachable variable is not restored by the saver or is partitioned
+    bool restoreReachableVariables(Session* session,
+                                   const MetaGraphDef& metaGraphDef,
+                                   const std::string& varFile,
+                                   const std::vector<std::string>& outputNames) {
+      const GraphDef& graphDef = metaGraphDef.graph_def();
+      std::map<std::string, const NodeDef*> nodes;
+      for (const NodeDef& node : graphDef.node()) {
+        nodes[node.name()] = &node;
+      }
+
+      // find variables reachable from the outputs, including control dependencies
+      std::set<std::string> reachable;
+      std::vector<std::string> queue;
+      for (const std::string& outputName : outputNames) {
+        queue.push_back(std::string(ParseTensorName(outputName).node()));
+      }
+      while (!queue.empty()) {
+        std::string name = queue.back();
+        queue.pop_back();
+        auto it = nodes.find(name);
+        if (it == nodes.end() || !reachable.insert(name).second) {
+          continue;
+        }
+        for (const std::string& input : it->second->input()) {
+          queue.push_back(std::string(ParseTensorName(input).node()));
+        }
+      }
+      std::set<std::string> variables;
+      for (const std::string& name : reachable) {
+        const std::string& op = nodes[name]->op();
+        if (op == "VariableV2" || op == "Variable" || op == "VarHandleOp") {
+          variables.insert(name);
+        }
+      }
+
+      // find the assign op, the fed value and the checkpoint key per variable
+      struct Restore {
+        std::string assignName;
+        std::string valueName;
+        std::string key;
+      };
+      std::map<std::string, Restore> restores;
+      for (const NodeDef& node : graphDef.node()) {
+        if ((node.op() != "Assign" && node.op() != "AssignVariableOp") || node.input_size() < 2) {
+          continue;
+        }
+        std::string variable(ParseTensorName(node.input(0)).node());
+        if (!variables.count(variable)) {
+          continue;
+        }
+
+        // follow the value through identities to a RestoreV2 op
+        TensorId value = ParseTensorName(node.input(1));
+        auto it = nodes.find(std::string(value.node()));
+        while (it != nodes.end() && it->second->op() == "Identity" && it->second->input_size() > 0) {
+          value = ParseTensorName(it->second->input(0));
+          it = nodes.find(std::string(value.node()));
+        }
+        if (it == nodes.end() || it->second->op() != "RestoreV2" || it->second->input_size() < 3) {
+          continue;
+        }
+        auto namesNode = nodes.find(std::string(ParseTensorName(it->second->input(1)).node()));
+        auto slicesNode = nodes.find(std::string(ParseTensorName(it->second->input(2)).node()));
+        if (namesNode == nodes.end() || namesNode->second->op() != "Const" || slicesNode == nodes.end() ||
+            slicesNode->second->op() != "Const") {
+          continue;
+        }
+        Tensor tensorNames, shapeAndSlices;
+        if (!tensorNames.FromProto(namesNode->second->attr().at("value").tensor()) ||
+            !shapeAndSlices.FromProto(slicesNode->second->attr().at("value").tensor()) ||
+            value.index() >= tensorNames.NumElements() || value.index() >= shapeAndSlices.NumElements()) {
+          continue;
+        }
+
+        // partitioned variables are restored from slices which cannot be looked up directly
+        if (!shapeAndSlices.flat<std::string>()(value.index()).empty()) {
+          return false;
+        }
+        restores[variable] = {node.name(), node.input(1), tensorNames.flat<std::string>()(value.index())};
+      }
+      if (restores.size() != variables.size()) {
+        return false;
+      }
+      if (restores.empty()) {
+        return true;
+      }
+
+      // read values from the checkpoint and assign them
+      BundleReader reader(Env::Default(), varFile);
+      if (!reader.status().ok()) {
+        throw cms::Exception("InvalidSession") << "error while reading variables: " << reader.status().ToString();
+      }
+      std::vector<std::pair<std::string, Tensor>> feeds;
+      std::vector<std::string> targets;
+      for (const auto& it : restores) {
+        Tensor value;
+        Status status = reader.Lookup(it.second.key, &value);
+        if (!status.ok()) {
+          throw cms::Exception("InvalidSession")
+              << "error while reading variable '" << it.first << "': " << status.ToString();
+        }
+        feeds.emplace_back(it.second.valueName, value);
+        targets.push_back(it.second.assignName);
+      }
+      Status status = session->Run(feeds, {}, targets, nullptr);
+      if (!status.ok()) {
+        throw cms::Exception("InvalidSession") << "error while restoring variables in session: " << status.ToString();
+      }
+
+      return true;
+    }
+
+    // zero-copy stream decompressing a zstd buffer in chunks, so that protobufs can be parsed
+    // without an uncompressed copy of the whole buffer
+    class ZstdInputStream : public protobuf::io::ZeroCopyInputStream {
+    public:
+      ZstdInputStream(const void* data, size_t size)
+          : stream_(ZSTD_createDStream()),
+            input_{data, size, 0},
+            buffer_(ZSTD_DStreamOutSize()),
+            bufferSize_(0),
+            backedUp_(0),
+            byteCount_(0),
+            remaining_(1) {
+        ZSTD_initDStream(stream_);
+      }
+
+      ~ZstdInputStream() override { ZSTD_freeDStream(stream_); }
+
+      bool Next(const void** data, int* size) override {
+        // return bytes that were backed up first
+        if (backedUp_ > 0) {
+          *data = buffer_.data() + bufferSize_ - backedUp_;
+          *size = backedUp_;
+          byteCount_ += backedUp_;
+          backedUp_ = 0;
+          return true;
+        }
+
+        // decompress until there is output, which may be pending even when all input is consumed
+        while (true) {
+          ZSTD_outBuffer output = {buffer_.data(), buffer_.size(), 0};
+          remaining_ = ZSTD_decompressStream(stream_, &output, &input_);
+          if (ZSTD_isError(remaining_)) {
+            return false;
+          }
+          if (output.pos > 0) {
+            bufferSize_ = output.pos;
+            *data = buffer_.data();
+            *size = int(output.pos);
+            byteCount_ += output.pos;
+            return true;
+          }
+          if (input_.pos >= input_.size) {
+            return false;
+          }
+        }
+      }
+
+      void BackUp(int count) override {
+        backedUp_ = count;
+        byteCount_ -= count;
+      }
+
+      bool Skip(int count) override {
+        const void* data;
+        int size;
+        while (count > 0 && Next(&data, &size)) {
+          if (size > count) {
+            BackUp(size - count);
+            return true;
+          }
+          count -= size;
+        }
+        return count == 0;
+      }
+
+      protobuf::int64 ByteCount() const override { return byteCount_; }
+
+      // returns whether the input was a complete, valid frame
+      bool ok() const { return remaining_ == 0; }
+
+    private:
+      ZSTD_DStream* stream_;
+      ZSTD_inBuffer input_;
+      std::vector<char> buffer_;
+      size_t bufferSize_;
+      int backedUp_;
+      protobuf::int64 byteCount_;
+      size_t remaining_;
+    };
+
+    // zero-copy stream decompressing a gzip buffer in chunks using zlib directly, as opposed to the
+    // protobuf gzip stream which does not report whether the stream was complete
+    class GzipInflateStream : public protobuf::io::ZeroCopyInputStream {
+    public:
+      GzipInflateStream(const void* data, size_t size)
+          : buffer_(1 << 16), bufferSize_(0), backedUp_(0), byteCount_(0), status_(Z_OK) {
+        std::memset(&stream_, 0, sizeof(stream_));
+        stream_.next_in = static_cast<Bytef*>(const_cast<void*>(data));
+        stream_.avail_in = uInt(size);
+        // the window bits offset enables the gzip header and trailer, which is verified by inflate
+        if (inflateInit2(&stream_, 16 + MAX_WBITS) != Z_OK) {
+          status_ = Z_STREAM_ERROR;
+        }
+      }
+
+      ~GzipInflateStream() override {
+        if (status_ != Z_STREAM_ERROR) {
+          inflateEnd(&stream_);
+        }
+      }
+
+      bool Next(const void** data, int* size) override {
+        // return bytes that were backed up first
+        if (backedUp_ > 0) {
+          *data = buffer_.data() + bufferSize_ - backedUp_;
+          *size = backedUp_;
+          byteCount_ += backedUp_;
+          backedUp_ = 0;
+          return true;
+        }
+
+        // inflate until there is output, the end of the stream is reached or the input is exhausted
+        while (status_ == Z_OK) {
+          stream_.next_out = reinterpret_cast<Bytef*>(buffer_.data());
+          stream_.avail_out = uInt(buffer_.size());
+          status_ = inflate(&stream_, Z_NO_FLUSH);
+          if (status_ != Z_OK && status_ != Z_STREAM_END) {
+            return false;
+          }
+          size_t produced = buffer_.size() - stream_.avail_out;
+          if (produced > 0) {
+            bufferSize_ = produced;
+            *data = buffer_.data();
+            *size = int(produced);
+            byteCount_ += produced;
+            return true;
+          }
+          if (status_ == Z_OK && stream_.avail_in == 0) {
+            return false;
+          }
+        }
+        return false;
+      }
+
+      void BackUp(int count) override {
+        backedUp_ = count;
+        byteCount_ -= count;
+      }
+
+      bool Skip(int count) override {
+        const void* data;
+        int size;
+        while (count > 0 && Next(&data, &size)) {
+          if (size > count) {
+            BackUp(size - count);
+            return true;
+          }
+          count -= size;
+        }
+        return count == 0;
+      }
+
+      protobuf::int64 ByteCount() const override { return byteCount_; }
+
+      // returns whether the input was a single, complete stream whose trailer matched
+      bool ok() const { return status_ == Z_STREAM_END && stream_.avail_in == 0; }
+
+    private:
+      z_stream stream_;
+      std::vector<char> buffer_;
+      size_t bufferSize_;
+      int backedUp_;
+      protobuf::int64 byteCount_;
+      int status_;
+    };
+
+    // parses a binary protobuf message from a buffer that is optionally compressed with zstd or
+    // gzip as detected by its magic bytes
+    Status parseProto(const void* data, size_t size, protobuf::Message* message) {
+      if (data == nullptr || size == 0) {
+        return errors::InvalidArgument("empty buffer");
+      }
+      if (size > size_t(std::numeric_limits<int>::max())) {
+        return errors::InvalidArgument("buffer of ", size, " bytes exceeds the protobuf size limit");
+      }
+      const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+      // parses a message from a stream with the same limits as ReadBinaryProto
+      auto parse = [message](protobuf::io::ZeroCopyInputStream* stream) {
+        protobuf::io::CodedInputStream codedStream(stream);
+        codedStream.SetTotalBytesLimit(1024LL << 20, 512LL << 20);
+        return message->ParseFromCodedStream(&codedStream) && codedStream.ConsumedEntireMessage();
+      };
+
+      if (size >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) {
+        ZstdInputStream stream(data, size);
+        if (!parse(&stream) || !stream.ok()) {
+          return errors::DataLoss("cannot parse zstd compressed protobuf");
+        }
+      } else if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+        // a truncated stream can still contain a valid message, so also check that it was complete
+        GzipInflateStream stream(data, size);
+        if (!parse(&stream) || !stream.ok()) {
+          return errors::DataLoss("cannot parse gzip compressed protobuf");
+        }
+      } else {
+        protobuf::io::ArrayInputStream stream(data, int(size));
+        if (!parse(&stream)) {
+          return errors::DataLoss("cannot parse protobuf");
+        }
+      }
+
+      return Status::OK();
+    }
+
+    // returns whether the file at path starts with the magic bytes of zstd or gzip
+    bool isCompressedFile(const std::string& path) {
+      std::unique_ptr<RandomAccessFile> file;
+      if (!Env::Default()->NewRandomAccessFile(path, &file).ok()) {
+        return false;
+      }
+      char scratch[4];
+      StringPiece magic;
+      file->Read(0, 4, &magic, scratch).IgnoreError();
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(magic.data());
+      return (magic.size() >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) ||
+             (magic.size() >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b);
+    }
+
+  }  // namespace
+
   void setLogging(const std::string& level) { setenv("TF_CPP_MIN_LOG_LEVEL", level.c_str(), 0); }
 
   void setThreading(SessionOptions& sessionOptions, int nThreads) {
@@ -27,20 +447,16 @@ namespace tensorflow {
   }
 
   MetaGraphDef* loadMetaGraphDef(const std::string& exportDir, const std::string& tag, SessionOptions& sessionOptions) {
-    // objects to load the graph
-    Status status;
-    RunOptions runOptions;
-    SavedModelBundle bundle;
-
-    // load the model
-    status = LoadSavedModel(sessionOptions, runOptions, exportDir, {tag}, &bundle);
+    // read only the meta graph, as loading the full model would create a session and restore all
+    // variables just to discard them
+    std::unique_ptr<MetaGraphDef> metaGraphDef(new MetaGraphDef());
+    Status status = ReadMetaGraphDefFromSavedModel(exportDir, {tag}, metaGraphDef.get());
     if (!status.ok()) {
       throw cms::Exception("InvalidMetaGraphDef")
           << "error while loading metaGraphDef from '" << exportDir << "': " << status.ToString();
     }
 
-    // return a copy of the graph
-    return new MetaGraphDef(bundle.meta_graph_def);
+    return metaGraphDef.release();
   }
 
   MetaGraphDef* loadMetaGraph(const std::string& exportDir, const std::string& tag, SessionOptions& sessionOptions) {
@@ -69,9 +485,17 @@ namespace tensorflow {
     // objects to load the graph
     Status status;
 
-    // load it
+    // load it, parsing compressed files from their compressed content
     GraphDef* graphDef = new GraphDef();
-    status = ReadBinaryProto(Env::Default(), pbFile, graphDef);
+    if (isCompressedFile(pbFile)) {
+      std::string content;
+      status = ReadFileToString(Env::Default(), pbFile, &content);
+      if (status.ok()) {
+        status = parseProto(content.data(), content.size(), graphDef);
+      }
+    } else {
+      status = ReadBinaryProto(Env::Default(), pbFile, graphDef);
+    }
 
     // check for success
     if (!status.ok()) {
@@ -82,6 +506,140 @@ namespace tensorflow {
     return graphDef;
   }
 
+  GraphDef* loadGraphDefFromBuffer(const void* data, size_t size) {
+    std::unique_ptr<GraphDef> graphDef(new GraphDef());
+    Status status = parseProto(data, size, graphDef.get());
+    if (!status.ok()) {
+      throw cms::Exception("InvalidGraphDef") << "error while loading graphDef from buffer: " << status.ToString();
+    }
+
+    return graphDef.release();
+  }
+
+  MetaGraphDef* loadMetaGraphDefFromBuffer(const void* data, size_t size, const std::string& tag) {
+    SavedModel savedModel;
+    Status status = parseProto(data, size, &savedModel);
+    if (!status.ok()) {
+      throw cms::Exception("InvalidMetaGraphDef")
+          << "error while loading metaGraphDef from buffer: " << status.ToString();
+    }
+
+    // return the first meta graph with a matching tag
+    for (const MetaGraphDef& metaGraphDef : savedModel.meta_graphs()) {
+      const auto& tags = metaGraphDef.meta_info_def().tags();
+      if (std::find(tags.begin(), tags.end(), tag) != tags.end()) {
+        return new MetaGraphDef(metaGraphDef);
+      }
+    }
+    throw cms::Exception("InvalidMetaGraphDef")
+        << "error while loading metaGraphDef from buffer: no meta graph with tag '" << tag << "'";
+  }
+
+  GraphDef* mergeGraphDefs(const std::vector<std::pair<std::string, const GraphDef*>>& graphDefs,
+                           const std::vector<std::string>& sharedInputs) {
+    std::set<std::string> shared(sharedInputs.begin(), sharedInputs.end());
+    std::set<std::string> namespaces;
+    std::map<std::string, const NodeDef*> sharedNodes;
+    std::map<std::string, const FunctionDef*> functions;
+    std::map<std::string, std::string> gradients;
+
+    std::unique_ptr<GraphDef> mergedGraphDef(new GraphDef());
+    for (const auto& it : graphDefs) {
+      const std::string& ns = it.first;
+      const GraphDef* graphDef = it.second;
+
+      // check the namespace and the graph
+      if (ns.empty() || !namespaces.insert(ns).second) {
+        throw cms::Exception("InvalidGraphDef") << "error while merging graphDefs: namespace '" << ns
+                                                << "' is empty or not unique";
+      }
+      if (graphDef == nullptr) {
+        throw cms::Exception("InvalidGraphDef") << "error while merging graphDefs: graphDef '" << ns << "' is nullptr";
+      }
+
+      // prefixes a node name unless it refers to a shared input, keeping control markers and
+      // output indices
+      auto rename = [&ns, &shared](const std::string& name) {
+        size_t start = (!name.empty() && name[0] == '^') ? 1 : 0;
+        size_t end = name.find(':', start);
+        std::string nodeName = name.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (shared.count(nodeName)) {
+          return name;
+        }
+        return name.substr(0, start) + ns + "/" + name.substr(start);
+      };
+
+      for (const NodeDef& node : graphDef->node()) {
+        // add shared inputs only once
+        if (shared.count(node.name())) {
+          auto sharedNode = sharedNodes.find(node.name());
+          bool isPlaceholder = node.op() == "Placeholder" && node.attr().count("dtype");
+          if (!isPlaceholder || (sharedNode != sharedNodes.end() &&
+                                 sharedNode->second->attr().at("dtype").type() != node.attr().at("dtype").type())) {
+            throw cms::Exception("InvalidGraphDef")
+                << "error while merging graphDefs: shared input '" << node.name() << "' in graphDef '" << ns
+                << "' is not a compatible placeholder";
+          }
+          if (sharedNode == sharedNodes.end()) {
+            sharedNodes[node.name()] = &node;
+            *mergedGraphDef->add_node() = node;
+          }
+          continue;
+        }
+
+        // copy the node and rename it, its inputs and colocation constraints
+        NodeDef* newNode = mergedGraphDef->add_node();
+        *newNode = node;
+        newNode->set_name(rename(node.name()));
+        for (int i = 0; i < newNode->input_size(); i++) {
+          newNode->set_input(i, rename(newNode->input(i)));
+        }
+        auto classAttr = newNode->mutable_attr()->find("_class");
+        if (classAttr != newNode->mutable_attr()->end()) {
+          auto* classes = classAttr->second.mutable_list();
+          for (int i = 0; i < classes->s_size(); i++) {
+            const std::string& loc = classes->s(i);
+            if (loc.compare(0, 5, "loc:@") == 0) {
+              classes->set_s(i, "loc:@" + rename(loc.substr(5)));
+            }
+          }
+        }
+      }
+
+      // merge function libraries, skipping functions that are already defined identically
+      for (const FunctionDef& function : graphDef->library().function()) {
+        const std::string& name = function.signature().name();
+        auto it = functions.find(name);
+        if (it == functions.end()) {
+          functions[name] = &function;
+          *mergedGraphDef->mutable_library()->add_function() = function;
+        } else if (!FunctionDefsEqual(*it->second, function)) {
+          throw cms::Exception("InvalidGraphDef")
+              << "error while merging graphDefs: function '" << name << "' in graphDef '" << ns
+              << "' conflicts with a previous definition";
+        }
+      }
+      for (const GradientDef& gradient : graphDef->library().gradient()) {
+        auto it = gradients.find(gradient.function_name());
+        if (it == gradients.end()) {
+          gradients[gradient.function_name()] = gradient.gradient_func();
+          *mergedGraphDef->mutable_library()->add_gradient() = gradient;
+        } else if (it->second != gradient.gradient_func()) {
+          throw cms::Exception("InvalidGraphDef")
+              << "error while merging graphDefs: gradient of function '" << gradient.function_name()
+              << "' in graphDef '" << ns << "' conflicts with a previous definition";
+        }
+      }
+
+      // use the versions of the first graph
+      if (!mergedGraphDef->has_versions()) {
+        *mergedGraphDef->mutable_versions() = graphDef->versions();
+      }
+    }
+
+    return mergedGraphDef.release();
+  }
+
   Session* createSession(SessionOptions& sessionOptions) {
     // objects to create the session
     Status status;
@@ -105,58 +663,66 @@ namespace tensorflow {
   }
 
   Session* createSession(MetaGraphDef* metaGraphDef, const std::string& exportDir, SessionOptions& sessionOptions) {
-    // check for valid pointer
-    if (metaGraphDef == nullptr) {
-      throw cms::Exception("InvalidMetaGraphDef") << "error while creating session: metaGraphDef is nullptr";
+    Session* session = createMetaGraphSession(metaGraphDef, sessionOptions);
+
+    // restore variables using the variable and index files in the export directory, unless the
+    // index file is missing in which case there's nothing to do
+    std::string varFile = variablesFile(exportDir);
+    if (Env::Default()->FileExists(MetaFilename(varFile)).ok()) {
+      try {
+        restoreAllVariables(session, *metaGraphDef, varFile);
+      } catch (...) {
+        closeSession(session);
+        throw;
+      }
     }
 
-    // check that the graph has nodes
-    if (metaGraphDef->graph_def().node_size() <= 0) {
-      throw cms::Exception("InvalidMetaGraphDef") << "error while creating session: graphDef has no nodes";
-    }
+    return session;
+  }
 
-    Session* session = createSession(sessionOptions);
+  Session* createSession(MetaGraphDef* metaGraphDef, const std::string& exportDir, int nThreads) {
+    // create session options and set thread options
+    SessionOptions sessionOptions;
+    setThreading(sessionOptions, nThreads);
 
-    // add the graph def from the meta graph
-    Status status;
-    status = session->Create(metaGraphDef->graph_def());
-    if (!status.ok()) {
-      throw cms::Exception("InvalidMetaGraphDef")
-          << "error while attaching metaGraphDef to session: " << status.ToString();
-    }
+    return createSession(metaGraphDef, exportDir, sessionOptions);
+  }
 
-    // restore variables using the variable and index files in the export directory
-    // first, find names and paths
-    std::string varFileTensorName = metaGraphDef->saver_def().filename_tensor_name();
-    std::string restoreOpName = metaGraphDef->saver_def().restore_op_name();
-    std::string varDir = io::JoinPath(exportDir, kSavedModelVariablesDirectory);
-    std::string indexFile = io::JoinPath(varDir, MetaFilename(kSavedModelVariablesFilename));
-    std::string varFile = io::JoinPath(varDir, kSavedModelVariablesFilename);
+  Session* createSession(MetaGraphDef* metaGraphDef,
+                         const std::string& exportDir,
+                         const std::vector<std::string>& outputNames,
+                         SessionOptions& sessionOptions) {
+    Session* session = createMetaGraphSession(metaGraphDef, sessionOptions);
 
-    // when the index file is missing, there's nothing to do
-    if (!Env::Default()->FileExists(indexFile).ok()) {
+    std::string varFile = variablesFile(exportDir);
+    if (!Env::Default()->FileExists(MetaFilename(varFile)).ok()) {
       return session;
     }
 
-    // create a tensor to store the variable file
-    Tensor varFileTensor(DT_STRING, TensorShape({}));
-    varFileTensor.scalar<std::string>()() = varFile;
-
-    // run the restore op
-    status = session->Run({{varFileTensorName, varFileTensor}}, {}, {restoreOpName}, nullptr);
-    if (!status.ok()) {
-      throw cms::Exception("InvalidSession") << "error while restoring variables in session: " << status.ToString();
+    // restore only variables required for outputNames when possible
+    try {
+      if (!restoreReachableVariables(session, *metaGraphDef, varFile, outputNames)) {
+        edm::LogInfo("PhysicsTools/TensorFlow")
+            << "variables required for outputs cannot be restored selectively, restoring all variables";
+        restoreAllVariables(session, *metaGraphDef, varFile);
+      }
+    } catch (...) {
+      closeSession(session);
+      throw;
     }
 
     return session;
   }
 
-  Session* createSession(MetaGraphDef* metaGraphDef, const std::string& exportDir, int nThreads) {
+  Session* createSession(MetaGraphDef* metaGraphDef,
+                         const std::string& exportDir,
+                         const std::vector<std::string>& outputNames,
+                         int nThreads) {
     // create session options and set thread options
     SessionOptions sessionOptions;
     setThreading(sessionOptions, nThreads);
 
-    return createSession(metaGraphDef, exportDir, sessionOptions);
+    return createSession(metaGraphDef, exportDir, outputNames, sessionOptions);
   }
 
   Session* createSession(GraphDef* graphDef, SessionOptions& sessionOptions) {
@@ -172,13 +738,15 @@ namespace tensorflow {
 
     // create a new, empty session
     Session* session = createSession(sessionOptions);
+    trackSession(session, *graphDef);
 
     // add the graph def
     Status status;
     status = session->Create(*graphDef);
 
-    // check for success
+    // check for success, closing the session on failure to stop tracking it
     if (!status.ok()) {
+      closeSession(session);
       throw cms::Exception("InvalidSession") << "error while attaching graphDef to session: " << status.ToString();
     }
 
@@ -198,7 +766,8 @@ namespace tensorflow {
       return true;
     }
 
-    // close and delete the session
+    // stop tracking, close and delete the session
+    MemoryTracker::instance().unregisterSession(session);
     Status status = session->Close();
     delete session;
 
@@ -220,11 +789,54 @@ namespace tensorflow {
     // create empty run options
     RunOptions runOptions;
 
+    // when tracking memory, check the budget and trace the run if requested
+    MemoryTracker& tracker = MemoryTracker::instance();
+    bool trackMemory = tracker.enabled();
+    bool traceRun = false;
+    int64 reservedBytes = 0;
+    if (trackMemory) {
+      int64 inputBytes = 0;
+      for (const NamedTensor& input : inputs) {
+        inputBytes += input.second.TotalBytes();
+      }
+      traceRun = tracker.beginRun(session, inputBytes, &reservedBytes);
+      if (traceRun) {
+        runOptions.set_trace_level(RunOptions::SOFTWARE_TRACE);
+      }
+    }
+
+    // when capturing, check if this run is sampled
+    RunCapture& capture = RunCapture::instance();
+    bool captureRun = capture.active() && capture.sample(session);
+    auto startTime = std::chrono::steady_clock::now();
+
     // run and check the status
-    Status status = session->Run(runOptions, inputs, outputNames, {}, outputs, nullptr, threadPoolOptions);
+    RunMetadata runMetadata;
+    Status status = session->Run(
+        runOptions, inputs, outputNames, {}, outputs, traceRun ? &runMetadata : nullptr, threadPoolOptions);
     if (!status.ok()) {
+      if (trackMemory) {
+        tracker.cancelRun(session, reservedBytes);
+      }
       throw cms::Exception("InvalidRun") << "error while running session: " << status.ToString();
     }
+
+    // release the reserved bytes
+    if (trackMemory) {
+      int64 outputBytes = 0;
+      if (outputs != nullptr) {
+        for (const Tensor& output : *outputs) {
+          outputBytes += output.TotalBytes();
+        }
+      }
+      tracker.endRun(session, traceRun ? &runMetadata : nullptr, outputBytes, reservedBytes);
+    }
+
+    if (captureRun) {
+      auto duration = std::chrono::steady_clock::now() - startTime;
+      capture.record(
+          session, inputs, outputNames, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
   }
 
   void run(Session* session,
@@ -0,0 +1,95 @@
+# coding: utf-8
+
+"""
+Test script to create small dense graphs at bin/data that cover all ops supported by the native
+graph evaluator, and save them with all variables converted to constants.
+"""
+
+
+import os
+import sys
+import tensorflow as tf
+
+from PhysicsTools.TensorFlow.tools import TF2, write_constant_graph
+
+
+# go into v1 compatibility mode
+if TF2:
+    tf = tf.compat.v1
+tf.disable_eager_execution()
+
+# prepare the datadir
+if len(sys.argv) >= 2:
+    datadir = sys.argv[1]
+else:
+    thisdir = os.path.dirname(os.path.abspath(__file__))
+    datadir = os.path.join(os.path.dirname(thisdir), "bin", "data")
+
+
+def dense(x, n, name):
+    W = tf.Variable(tf.random_normal([int(x.shape[1]), n], seed=1), name=name + "_W")
+    b = tf.Variable(tf.random_normal([n], seed=2), name=name + "_b")
+    return tf.nn.bias_add(tf.matmul(x, W), b)
+
+
+def write(name, create):
+    graph = tf.Graph()
+    with graph.as_default():
+        x_ = tf.placeholder(tf.float32, [None, 4], name="input")
+        output_names = create(x_)
+        with tf.Session() as sess:
+            sess.run(tf.global_variables_initializer())
+            write_constant_graph(sess, output_names, os.path.join(datadir, name + ".pb"))
+
+
+# one graph per activation fused into a dense layer
+activations = {
+    "relu": tf.nn.relu,
+    "relu6": tf.nn.relu6,
+    "elu": tf.nn.elu,
+    "sigmoid": tf.nn.sigmoid,
+    "tanh": tf.nn.tanh,
+    "softmax": tf.nn.softmax,
+}
+for act_name, act in activations.items():
+    write("native_" + act_name, lambda x_, act=act: [act(dense(x_, 3, "l"), name="output").op.name])
+
+
+# concatenation of two branches followed by another dense layer
+def create_concat(x_):
+    h = tf.concat([tf.nn.relu(dense(x_, 3, "a")), tf.nn.tanh(dense(x_, 2, "b"))], axis=1)
+    return [tf.identity(dense(h, 2, "c"), name="output").op.name]
+
+
+write("native_concat", create_concat)
+
+
+# two consumers of the same dense layer, one of them via an identity
+def create_shared(x_):
+    h = dense(x_, 3, "l")
+    y1 = tf.nn.sigmoid(h, name="output")
+    y2 = tf.nn.relu(tf.identity(h), name="output2")
+    return [y1.op.name, y2.op.name]
+
+
+write("native_shared", create_shared)
+
+
+# the layer output itself is fetched via an identity next to an activation
+def create_shared_output(x_):
+    h = dense(x_, 3, "l")
+    y1 = tf.nn.tanh(h, name="output")
+    y2 = tf.identity(h, name="output2")
+    return [y1.op.name, y2.op.name]
+
+
+write("native_shared_output", create_shared_output)
+
+
+# element-wise scaling with a placeholder of unknown rank
+def create_broadcast(x_):
+    scale_ = tf.placeholder(tf.float32, name="scale")
+    return [tf.multiply(dense(x_, 4, "l"), scale_, name="output").op.name]
+
+
+write("native_broadcast", create_broadcast)
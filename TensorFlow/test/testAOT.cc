@@ -9,6 +9,9 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <stdexcept>
 
+#include "PhysicsTools/TensorFlow/interface/AOTBatchDispatcher.h"
+#include "PhysicsTools/TensorFlow/interface/TBBThreadPoolDevice.h"
+
 #include "testAOT_add/header.h"
 
 using AddComp = testAOT_add;
@@ -73,4 +76,40 @@ void testAOT::checkAll() {
     CPPUNIT_ASSERT(add.result0_data()[0] == 42);
     CPPUNIT_ASSERT(add.result0_data() == add.results()[0]);
   }
+
+  // run with a TBB-backed Eigen thread pool device attached
+  {
+    std::cout << "testing tf add with tbb thread pool device" << std::endl;
+    tensorflow::TBBThreadPoolDevice device(2);
+    CPPUNIT_ASSERT(device.NumThreads() == 2);
+
+    AddComp add;
+    device.attach(add);
+
+    add.arg0() = 5;
+    add.arg1() = 6;
+    CPPUNIT_ASSERT(add.Run());
+    CPPUNIT_ASSERT(add.error_msg() == "");
+    CPPUNIT_ASSERT(add.result0() == 11);
+  }
+
+  // dispatch multiple rows to the single-row variant, which requires splitting
+  {
+    std::cout << "testing tf add with batch dispatcher" << std::endl;
+    tensorflow::AOTBatchDispatcher<int> dispatcher({1, 1}, {1});
+    CPPUNIT_ASSERT_THROW(dispatcher.run({}, {}, 1), cms::Exception);
+
+    dispatcher.addVariant<AddComp>(1);
+    CPPUNIT_ASSERT_THROW(dispatcher.addVariant<AddComp>(1), cms::Exception);
+    CPPUNIT_ASSERT(dispatcher.batchSizes() == std::vector<size_t>({1}));
+
+    tensorflow::TBBThreadPoolDevice device(2);
+    dispatcher.setThreadPool(device);
+
+    std::vector<int> x = {1, 2, 3};
+    std::vector<int> y = {10, 20, 30};
+    std::vector<int> sum(3, 0);
+    dispatcher.run({x.data(), y.data()}, {sum.data()}, 3);
+    CPPUNIT_ASSERT(sum == std::vector<int>({11, 22, 33}));
+  }
 }
@@ -0,0 +1,115 @@
+/*
+ * Tests for dispatching rows to AOT functions compiled for several batch sizes, using minimal
+ * stub functions that are set up like the classes generated by tfcompile.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/AOTBatchDispatcher.h"
+
+class testAOTBatchDispatcher : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(testAOTBatchDispatcher);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void checkAll();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testAOTBatchDispatcher);
+
+// stub of a function compiled for batchSize rows of rowSize floats, which adds the batch size to
+// all values, so that the variant used per row can be identified
+// buffers are the argument, the result tuple and the result
+template <size_t batchSize, size_t rowSize = 2>
+class AddBatchSize : public tensorflow::XlaCompiledCpuFunction {
+public:
+  static int nRuns;
+
+  AddBatchSize() : tensorflow::XlaCompiledCpuFunction(staticData()) {}
+
+private:
+  static void entryPoint(void* result,
+                         const xla::ExecutableRunOptions*,
+                         const void**,
+                         void** buffers,
+                         tensorflow::int64*) {
+    const float* arg = static_cast<const float*>(buffers[0]);
+    float* values = static_cast<float*>(buffers[2]);
+    for (size_t i = 0; i < batchSize * rowSize; i++) {
+      values[i] = arg[i] + float(batchSize);
+    }
+    static_cast<void**>(result)[0] = values;
+    nRuns++;
+  }
+
+  static const StaticData& staticData() {
+    static const StaticData* data = []() {
+      static const xla::cpu_function_runtime::BufferInfo bufferInfos[] = {
+          xla::cpu_function_runtime::BufferInfo::MakeEntryParameter(batchSize * rowSize * sizeof(float), 0),
+          xla::cpu_function_runtime::BufferInfo::MakeTempBuffer(sizeof(void*)),
+          xla::cpu_function_runtime::BufferInfo::MakeTempBuffer(batchSize * rowSize * sizeof(float))};
+      static const tensorflow::int32 argIndexTable[] = {0};
+      static const tensorflow::int32 resultIndexTable[] = {2};
+      StaticData* data = new StaticData;
+      set_static_data_raw_function(data, entryPoint);
+      set_static_data_buffer_infos(data, bufferInfos);
+      set_static_data_num_buffers(data, 3);
+      set_static_data_arg_index_table(data, argIndexTable);
+      set_static_data_num_args(data, 1);
+      set_static_data_result_index_table(data, resultIndexTable);
+      set_static_data_num_results(data, 1);
+      set_static_data_result_index(data, 1);
+      return data;
+    }();
+    return *data;
+  }
+};
+
+template <size_t batchSize, size_t rowSize>
+int AddBatchSize<batchSize, rowSize>::nRuns = 0;
+
+void testAOTBatchDispatcher::checkAll() {
+  tensorflow::AOTBatchDispatcher<float> dispatcher({2}, {2});
+  CPPUNIT_ASSERT_THROW(dispatcher.run({}, {}, 1), cms::Exception);
+
+  // variants must match the batch size and row sizes of the dispatcher
+  dispatcher.addVariant<AddBatchSize<1>>(1);
+  dispatcher.addVariant<AddBatchSize<4>>(4);
+  CPPUNIT_ASSERT_THROW(dispatcher.addVariant<AddBatchSize<4>>(4), cms::Exception);
+  CPPUNIT_ASSERT_THROW(dispatcher.addVariant<AddBatchSize<2>>(8), cms::Exception);
+  CPPUNIT_ASSERT_THROW(dispatcher.addVariant<AddBatchSize<2, 3>>(2), cms::Exception);
+  CPPUNIT_ASSERT_THROW(dispatcher.addVariant<AddBatchSize<2>>(0), cms::Exception);
+  CPPUNIT_ASSERT(dispatcher.batchSizes() == std::vector<size_t>({1, 4}));
+
+  // a single row uses the smallest variant
+  std::vector<float> x = {1., 2.};
+  std::vector<float> y(2, 0.);
+  dispatcher.run({x.data()}, {y.data()}, 1);
+  CPPUNIT_ASSERT(y == std::vector<float>({2., 3.}));
+  CPPUNIT_ASSERT(AddBatchSize<1>::nRuns == 1);
+  CPPUNIT_ASSERT(AddBatchSize<4>::nRuns == 0);
+
+  // three rows are padded to the variant with four rows
+  x = {0., 1., 2., 3., 4., 5.};
+  y.assign(6, 0.);
+  dispatcher.run({x.data()}, {y.data()}, 3);
+  CPPUNIT_ASSERT(y == std::vector<float>({4., 5., 6., 7., 8., 9.}));
+  CPPUNIT_ASSERT(AddBatchSize<4>::nRuns == 1);
+
+  // six rows are split into a chunk of four rows and one of two rows that is padded as well
+  x.assign(12, 0.);
+  y.assign(12, 0.);
+  dispatcher.run({x.data()}, {y.data()}, 6);
+  CPPUNIT_ASSERT(y == std::vector<float>(12, 4.));
+  CPPUNIT_ASSERT(AddBatchSize<4>::nRuns == 3);
+  CPPUNIT_ASSERT(AddBatchSize<1>::nRuns == 1);
+
+  // the number of arguments and results must match
+  CPPUNIT_ASSERT_THROW(dispatcher.run({x.data(), x.data()}, {y.data()}, 1), cms::Exception);
+}
@@ -0,0 +1,92 @@
+/*
+ * Tests for batched evaluation of object collections.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/BatchedRunner.h"
+
+#include "testBase.h"
+
+class testBatchedRunner : public testBase {
+  CPPUNIT_TEST_SUITE(testBatchedRunner);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testBatchedRunner);
+
+std::string testBatchedRunner::pyScript() const { return "createconstantgraph.py"; }
+
+void testBatchedRunner::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+
+  // load the graph and create a session
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+  scale.scalar<float>()() = 1.0;
+
+  // 95 objects whose 10 features are all set to their value, so that outputs are 10 * value + 1
+  std::vector<float> objects(95);
+  for (size_t i = 0; i < objects.size(); i++) {
+    objects[i] = float(i);
+  }
+  std::vector<std::string> featureNames;
+  for (size_t f = 0; f < 10; f++) {
+    featureNames.push_back("f" + std::to_string(f));
+  }
+  auto fill = [](float value, float* row) { std::fill(row, row + 10, value); };
+
+  CPPUNIT_ASSERT_THROW(tensorflow::BatchedRunner(nullptr, "input", featureNames, {"output"}), cms::Exception);
+
+  // chunks of 10 objects
+  tensorflow::BatchedRunner runner(session, "input", featureNames, {"output"}, {{"scale", scale}});
+  runner.setMaxChunkBytes(10 * 10 * sizeof(float));
+  CPPUNIT_ASSERT(runner.nFeatures() == 10);
+  CPPUNIT_ASSERT(runner.chunkSize() == 10);
+
+  for (bool parallel : {false, true}) {
+    runner.setParallel(parallel);
+    std::vector<float> results(objects.size(), -1.);
+    std::atomic<int> maxPosition(0);
+    runner.run(objects, fill, [&](size_t i, const std::vector<tensorflow::Tensor>& outputs, tensorflow::int64 pos) {
+      results[i] = outputs[0].matrix<float>()(pos, 0);
+      int p = pos;
+      int current = maxPosition;
+      while (p > current && !maxPosition.compare_exchange_weak(current, p)) {
+      }
+    });
+    for (size_t i = 0; i < objects.size(); i++) {
+      CPPUNIT_ASSERT(results[i] == 10. * i + 1.);
+    }
+    CPPUNIT_ASSERT(maxPosition == 9);
+  }
+
+  // tiny budgets still evaluate one object per chunk, empty collections do nothing
+  runner.setMaxChunkBytes(1);
+  CPPUNIT_ASSERT(runner.chunkSize() == 1);
+  size_t nCalls = 0;
+  runner.run(std::vector<float>(), fill, [&](size_t, const std::vector<tensorflow::Tensor>&, tensorflow::int64) {
+    nCalls++;
+  });
+  CPPUNIT_ASSERT(nCalls == 0);
+
+  // cleanup
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  delete graphDef;
+}
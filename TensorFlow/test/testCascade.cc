@@ -0,0 +1,113 @@
+/*
+ * Tests for cascaded evaluation of sessions.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/Cascade.h"
+
+#include "testBase.h"
+
+class testCascade : public testBase {
+  CPPUNIT_TEST_SUITE(testCascade);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testCascade);
+
+std::string testCascade::pyScript() const { return "createconstantgraph.py"; }
+
+void testCascade::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+
+  // load the graph and create a session
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+
+  // prepare inputs where all features of row i are i, so that outputs are (10 * i + 1) * scale
+  tensorflow::Tensor input(tensorflow::DT_FLOAT, {4, 10});
+  auto m = input.matrix<float>();
+  for (size_t i = 0; i < 4; i++) {
+    for (size_t j = 0; j < 10; j++) {
+      m(i, j) = float(i);
+    }
+  }
+  tensorflow::Tensor scale1(tensorflow::DT_FLOAT, {});
+  scale1.scalar<float>()() = 1.0;
+  tensorflow::Tensor scale2(tensorflow::DT_FLOAT, {});
+  scale2.scalar<float>()() = 2.0;
+
+  // first stage accepts rows 2 and 3, the second one scales them by 2
+  tensorflow::Cascade cascade;
+  CPPUNIT_ASSERT_THROW(cascade.run(input, nullptr), cms::Exception);
+  cascade.addStage(session, "input", {"output"}, tensorflow::Cascade::threshold(15.), {{"scale", scale1}});
+  cascade.addStage(session, "input", {"output"}, nullptr, {{"scale", scale2}});
+  CPPUNIT_ASSERT(cascade.nStages() == 2);
+
+  tensorflow::Cascade::Result result;
+  cascade.run(input, &result);
+  CPPUNIT_ASSERT(result.nStages() == 2);
+  CPPUNIT_ASSERT(result.rows[0].size() == 4);
+  CPPUNIT_ASSERT(result.rows[1] == std::vector<tensorflow::int64>({2, 3}));
+  CPPUNIT_ASSERT(result.outputs[0][0].matrix<float>()(3, 0) == 31.);
+  CPPUNIT_ASSERT(result.outputs[1][0].dim_size(0) == 2);
+  CPPUNIT_ASSERT(result.outputs[1][0].matrix<float>()(0, 0) == 42.);
+  CPPUNIT_ASSERT(result.position(1, 3) == 1);
+  CPPUNIT_ASSERT(result.position(1, 0) == -1);
+  CPPUNIT_ASSERT(result.lastStage(0) == 0);
+  CPPUNIT_ASSERT(result.lastStage(3) == 1);
+  CPPUNIT_ASSERT(result.scatter(1) == std::vector<float>({-1., -1., 42., 62.}));
+
+  // the input is not modified by the compaction
+  CPPUNIT_ASSERT(m(0, 0) == 0.);
+
+  // rejecting all rows stops early, the buffer is reused
+  tensorflow::Cascade strict;
+  strict.addStage(session, "input", {"output"}, tensorflow::Cascade::threshold(100.), {{"scale", scale1}});
+  strict.addStage(session, "input", {"output"}, nullptr, {{"scale", scale2}});
+  for (size_t i = 0; i < 2; i++) {
+    strict.run(input, &result);
+    CPPUNIT_ASSERT(result.nStages() == 1);
+    CPPUNIT_ASSERT(result.scatter(1, 0, 0, 0.) == std::vector<float>(4, 0.));
+  }
+
+  // outputs aliasing the fed rows are not modified by the compaction
+  tensorflow::Cascade aliasing;
+  aliasing.addStage(session, "input", {"output", "input"}, tensorflow::Cascade::threshold(15.), {{"scale", scale1}});
+  aliasing.addStage(session, "input", {"output"}, nullptr, {{"scale", scale2}});
+  aliasing.run(input, &result);
+  CPPUNIT_ASSERT(result.rows[1] == std::vector<tensorflow::int64>({2, 3}));
+  CPPUNIT_ASSERT(result.scatter(0, 1) == std::vector<float>({0., 1., 2., 3.}));
+
+  // predicates require float outputs
+  tensorflow::Tensor intOutput(tensorflow::DT_INT32, {1, 1});
+  intOutput.matrix<tensorflow::int32>()(0, 0) = 1;
+  CPPUNIT_ASSERT_THROW(tensorflow::Cascade::threshold(0.)({intOutput}, 0), cms::Exception);
+
+  // and columns in range of outputs with rank 2
+  tensorflow::Tensor floatOutput(tensorflow::DT_FLOAT, {2, 1});
+  floatOutput.matrix<float>()(1, 0) = 1.;
+  CPPUNIT_ASSERT(tensorflow::Cascade::threshold(0.5)({floatOutput}, 1));
+  CPPUNIT_ASSERT_THROW(tensorflow::Cascade::threshold(0., 0, 1)({floatOutput}, 0), cms::Exception);
+  tensorflow::Tensor vectorOutput(tensorflow::DT_FLOAT, {2});
+  CPPUNIT_ASSERT_THROW(tensorflow::Cascade::threshold(0.)({vectorOutput}, 0), cms::Exception);
+  tensorflow::Tensor scalarOutput(tensorflow::DT_FLOAT, {});
+  CPPUNIT_ASSERT_THROW(tensorflow::Cascade::threshold(0.)({scalarOutput}, 0), cms::Exception);
+
+  // cleanup
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  delete graphDef;
+}
@@ -0,0 +1,108 @@
+/*
+ * Tests for columnar files and the evaluation of their columns.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/ColumnarFile.h"
+#include "PhysicsTools/TensorFlow/interface/FeaturePacker.h"
+
+#include "testBase.h"
+
+class testColumnarFile : public testBase {
+  CPPUNIT_TEST_SUITE(testColumnarFile);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testColumnarFile);
+
+std::string testColumnarFile::pyScript() const { return "createconstantgraph.py"; }
+
+void testColumnarFile::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+  std::string inputFile = dataPath_ + "/input.tfcol";
+  std::string outputFile = dataPath_ + "/output.tfcol";
+
+  // write 10 feature columns of 100 rows where row i has all features set to i
+  std::vector<std::string> featureNames;
+  for (size_t f = 0; f < 10; f++) {
+    featureNames.push_back("f" + std::to_string(f));
+  }
+  size_t nRows = 100;
+  tensorflow::ColumnarFileWriter writer(inputFile, featureNames, nRows);
+  CPPUNIT_ASSERT(writer.nColumns() == 10);
+  for (size_t f = 0; f < 10; f++) {
+    for (size_t i = 0; i < nRows; i++) {
+      writer.column(f)[i] = float(i);
+    }
+  }
+  writer.close();
+
+  // read it back
+  tensorflow::ColumnarFile input(inputFile);
+  CPPUNIT_ASSERT(input.nRows() == nRows);
+  CPPUNIT_ASSERT(input.columnNames() == featureNames);
+  CPPUNIT_ASSERT(input.columnIndex("f3") == 3);
+  CPPUNIT_ASSERT_THROW(input.columnIndex("g"), cms::Exception);
+  CPPUNIT_ASSERT(input.column(9)[42] == 42.);
+  CPPUNIT_ASSERT(reinterpret_cast<uintptr_t>(input.column(1)) % 64 == 0);
+  CPPUNIT_ASSERT_THROW(tensorflow::ColumnarFile{pbFile}, cms::Exception);
+
+  // a corrupted number of rows whose column size overflows is rejected
+  std::string corruptedFile = dataPath_ + "/corrupted.tfcol";
+  {
+    std::ifstream in(inputFile, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    std::string bytes = content.str();
+    uint64_t corruptedRows = (uint64_t(1) << 62) + 1;
+    std::memcpy(&bytes[8], &corruptedRows, sizeof(corruptedRows));
+    std::ofstream out(corruptedFile, std::ios::binary);
+    out << bytes;
+  }
+  CPPUNIT_ASSERT_THROW(tensorflow::ColumnarFile{corruptedFile}, cms::Exception);
+
+  // evaluate the second half of rows and write outputs to a new file
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+
+  tensorflow::FeaturePacker packer(featureNames);
+  std::vector<const float*> columns;
+  for (size_t f = 0; f < 10; f++) {
+    columns.push_back(input.column(f) + 50);
+  }
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+  scale.scalar<float>()() = 1.0;
+  std::vector<tensorflow::Tensor> outputs;
+  tensorflow::run(session, {{"input", packer.packColumns(columns, 50)}, {"scale", scale}}, {"output"}, &outputs);
+
+  tensorflow::ColumnarFileWriter output(outputFile, {"output"}, 50);
+  std::copy_n(outputs[0].flat<float>().data(), 50, output.column(0));
+  output.close();
+
+  // output of row i is 10 * i + 1
+  tensorflow::ColumnarFile result(outputFile);
+  CPPUNIT_ASSERT(result.nRows() == 50);
+  CPPUNIT_ASSERT(result.column(0)[0] == 501.);
+  CPPUNIT_ASSERT(result.column(0)[49] == 991.);
+
+  // cleanup
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  delete graphDef;
+}
@@ -0,0 +1,85 @@
+/*
+ * Tests for packing object features into input tensors.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/FeaturePacker.h"
+
+class testFeaturePacker : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(testFeaturePacker);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void checkAll();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testFeaturePacker);
+
+struct TestJet {
+  float pt;
+  float eta;
+  std::vector<float> constituentPts;
+};
+
+void testFeaturePacker::checkAll() {
+  tensorflow::FeaturePacker packer({"pt", "eta"});
+  CPPUNIT_ASSERT(packer.nFeatures() == 2);
+  CPPUNIT_ASSERT(packer.featureIndex("eta") == 1);
+  CPPUNIT_ASSERT_THROW(packer.featureIndex("phi"), cms::Exception);
+  CPPUNIT_ASSERT_THROW(tensorflow::FeaturePacker({"pt", "pt"}), cms::Exception);
+
+  // structure of arrays
+  std::vector<float> pts = {10., 20., 30.};
+  std::vector<float> etas = {0.1, 0.2, 0.3};
+  tensorflow::Tensor t1 = packer.packColumns({pts.data(), etas.data()}, 3);
+  CPPUNIT_ASSERT(t1.shape() == tensorflow::TensorShape({3, 2}));
+  CPPUNIT_ASSERT(t1.matrix<float>()(2, 0) == 30.f);
+  CPPUNIT_ASSERT(t1.matrix<float>()(1, 1) == 0.2f);
+  CPPUNIT_ASSERT_THROW(packer.packColumns({pts.data()}, 3), cms::Exception);
+
+  // array of structures, the buffer is not reused while the previous tensor is still referenced
+  std::vector<TestJet> jets = {{15., 1.5, {1., 2.}}, {25., 2.5, {}}};
+  auto fillJet = [](const TestJet& jet, float* row) {
+    row[0] = jet.pt;
+    row[1] = jet.eta;
+  };
+  tensorflow::Tensor t2 = packer.packObjects(jets, fillJet);
+  CPPUNIT_ASSERT(t2.shape() == tensorflow::TensorShape({2, 2}));
+  CPPUNIT_ASSERT(t2.matrix<float>()(1, 0) == 25.f);
+  CPPUNIT_ASSERT(t2.flat<float>().data() != t1.flat<float>().data());
+  CPPUNIT_ASSERT(t1.matrix<float>()(0, 0) == 10.f);
+  CPPUNIT_ASSERT(t1.matrix<float>()(1, 1) == 0.2f);
+
+  // once released, the buffer is reused for a smaller batch
+  const float* t2Data = t2.flat<float>().data();
+  t2 = tensorflow::Tensor();
+  tensorflow::Tensor t2b = packer.packObjects(std::vector<TestJet>(jets.begin(), jets.begin() + 1), fillJet);
+  CPPUNIT_ASSERT(t2b.flat<float>().data() == t2Data);
+  CPPUNIT_ASSERT(t2b.matrix<float>()(0, 0) == 15.f);
+  CPPUNIT_ASSERT(t1.matrix<float>()(2, 0) == 30.f);
+
+  // padded and ragged sequences of constituents with a single feature
+  tensorflow::FeaturePacker cPacker({"pt"});
+  auto length = [](const TestJet& jet) { return jet.constituentPts.size(); };
+  auto fill = [](const TestJet& jet, size_t j, float* row) { row[0] = jet.constituentPts[j]; };
+
+  tensorflow::Tensor t3 = cPacker.packPadded(jets, 3, length, fill, -1.);
+  CPPUNIT_ASSERT(t3.shape() == tensorflow::TensorShape({2, 3, 1}));
+  CPPUNIT_ASSERT(t3.tensor<float, 3>()(0, 1, 0) == 2.f);
+  CPPUNIT_ASSERT(t3.tensor<float, 3>()(0, 2, 0) == -1.f);
+  CPPUNIT_ASSERT(t3.tensor<float, 3>()(1, 0, 0) == -1.f);
+
+  std::pair<tensorflow::Tensor, tensorflow::Tensor> t4 = cPacker.packRagged(jets, length, fill);
+  CPPUNIT_ASSERT(t4.first.shape() == tensorflow::TensorShape({2, 1}));
+  CPPUNIT_ASSERT(t4.first.matrix<float>()(1, 0) == 2.f);
+  CPPUNIT_ASSERT(t4.second.NumElements() == 3);
+  CPPUNIT_ASSERT(t4.second.flat<tensorflow::int64>()(1) == 2);
+  CPPUNIT_ASSERT(t4.second.flat<tensorflow::int64>()(2) == 2);
+}
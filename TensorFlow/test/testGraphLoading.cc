@@ -11,6 +11,10 @@
 
 #include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
 
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "zstd.h"
+
 #include "testBase.h"
 
 class testGraphLoading : public testBase {
@@ -73,7 +77,87 @@ void testGraphLoading::checkAll() {
   // check for exception
   CPPUNIT_ASSERT_THROW(tensorflow::run(session, {{"foo", input}}, {"output"}, &outputs), cms::Exception);
 
+  // merge the graph twice with shared inputs and evaluate both copies in a single run
+  tensorflow::GraphDef* mergedGraphDef =
+      tensorflow::mergeGraphDefs({{"a", graphDef}, {"b", graphDef}}, {"input", "scale"});
+  CPPUNIT_ASSERT(mergedGraphDef != nullptr);
+  CPPUNIT_ASSERT(mergedGraphDef->node_size() == 2 * graphDef->node_size() - 2);
+  tensorflow::Session* mergedSession = tensorflow::createSession(mergedGraphDef);
+  CPPUNIT_ASSERT(mergedSession != nullptr);
+
+  outputs.clear();
+  tensorflow::run(mergedSession, {{"input", input}, {"scale", scale}}, {"a/output", "b/output"}, &outputs);
+  CPPUNIT_ASSERT(outputs.size() == 2);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+  CPPUNIT_ASSERT(outputs[1].matrix<float>()(0, 0) == 46.);
+
+  // check for exceptions
+  CPPUNIT_ASSERT_THROW(tensorflow::mergeGraphDefs({{"a", graphDef}, {"a", graphDef}}), cms::Exception);
+  CPPUNIT_ASSERT_THROW(tensorflow::mergeGraphDefs({{"a", nullptr}}), cms::Exception);
+  CPPUNIT_ASSERT_THROW(tensorflow::mergeGraphDefs({{"a", graphDef}}, {"output"}), cms::Exception);
+
+  // functions of the same name are merged once when identical, and rejected otherwise
+  tensorflow::GraphDef functionGraphDef(*graphDef);
+  tensorflow::FunctionDef* function = functionGraphDef.mutable_library()->add_function();
+  function->mutable_signature()->set_name("f");
+  function->mutable_signature()->add_input_arg()->set_name("x");
+  tensorflow::GraphDef conflictingGraphDef(functionGraphDef);
+  conflictingGraphDef.mutable_library()->mutable_function(0)->mutable_signature()->add_input_arg()->set_name("y");
+  tensorflow::GraphDef* functionMergedGraphDef =
+      tensorflow::mergeGraphDefs({{"a", &functionGraphDef}, {"b", &functionGraphDef}}, {"input", "scale"});
+  CPPUNIT_ASSERT(functionMergedGraphDef->library().function_size() == 1);
+  delete functionMergedGraphDef;
+  CPPUNIT_ASSERT_THROW(
+      tensorflow::mergeGraphDefs({{"a", &functionGraphDef}, {"b", &conflictingGraphDef}}, {"input", "scale"}),
+      cms::Exception);
+
+  // load the graph from a buffer
+  std::string content;
+  CPPUNIT_ASSERT(tensorflow::ReadFileToString(tensorflow::Env::Default(), pbFile, &content).ok());
+  tensorflow::GraphDef* bufferGraphDef = tensorflow::loadGraphDefFromBuffer(content.data(), content.size());
+  CPPUNIT_ASSERT(bufferGraphDef != nullptr);
+  CPPUNIT_ASSERT(bufferGraphDef->node_size() == graphDef->node_size());
+  CPPUNIT_ASSERT_THROW(tensorflow::loadGraphDefFromBuffer(content.data(), 0), cms::Exception);
+  CPPUNIT_ASSERT_THROW(tensorflow::loadGraphDefFromBuffer("foo", 3), cms::Exception);
+
+  // compress it with zstd, then load it from the compressed buffer and file
+  std::string compressed(ZSTD_compressBound(content.size()), '\0');
+  size_t compressedSize = ZSTD_compress(&compressed[0], compressed.size(), content.data(), content.size(), 3);
+  CPPUNIT_ASSERT(!ZSTD_isError(compressedSize));
+  compressed.resize(compressedSize);
+  tensorflow::GraphDef* zstdGraphDef = tensorflow::loadGraphDefFromBuffer(compressed.data(), compressed.size());
+  CPPUNIT_ASSERT(zstdGraphDef->node_size() == graphDef->node_size());
+  CPPUNIT_ASSERT_THROW(tensorflow::loadGraphDefFromBuffer(compressed.data(), compressed.size() / 2), cms::Exception);
+
+  std::string zstdFile = pbFile + ".zst";
+  CPPUNIT_ASSERT(tensorflow::WriteStringToFile(tensorflow::Env::Default(), zstdFile, compressed).ok());
+  tensorflow::GraphDef* zstdFileGraphDef = tensorflow::loadGraphDef(zstdFile);
+  tensorflow::Session* zstdSession = tensorflow::createSession(zstdFileGraphDef);
+  outputs.clear();
+  tensorflow::run(zstdSession, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+
+  // compress it with gzip and load it from the compressed buffer, truncated streams are rejected
+  std::string gzipped;
+  {
+    google::protobuf::io::StringOutputStream stringStream(&gzipped);
+    google::protobuf::io::GzipOutputStream gzipStream(&stringStream);
+    CPPUNIT_ASSERT(graphDef->SerializeToZeroCopyStream(&gzipStream));
+    CPPUNIT_ASSERT(gzipStream.Close());
+  }
+  tensorflow::GraphDef* gzipGraphDef = tensorflow::loadGraphDefFromBuffer(gzipped.data(), gzipped.size());
+  CPPUNIT_ASSERT(gzipGraphDef->node_size() == graphDef->node_size());
+  CPPUNIT_ASSERT_THROW(tensorflow::loadGraphDefFromBuffer(gzipped.data(), gzipped.size() / 2), cms::Exception);
+  CPPUNIT_ASSERT_THROW(tensorflow::loadGraphDefFromBuffer(gzipped.data(), gzipped.size() - 4), cms::Exception);
+
   // cleanup
   CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  CPPUNIT_ASSERT(tensorflow::closeSession(mergedSession));
+  CPPUNIT_ASSERT(tensorflow::closeSession(zstdSession));
   delete graphDef;
+  delete mergedGraphDef;
+  delete bufferGraphDef;
+  delete zstdGraphDef;
+  delete zstdFileGraphDef;
+  delete gzipGraphDef;
 }
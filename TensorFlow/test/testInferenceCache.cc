@@ -0,0 +1,113 @@
+/*
+ * Tests for caching inference results.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/InferenceCache.h"
+
+#include "testBase.h"
+
+class testInferenceCache : public testBase {
+  CPPUNIT_TEST_SUITE(testInferenceCache);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testInferenceCache);
+
+std::string testInferenceCache::pyScript() const { return "createconstantgraph.py"; }
+
+void testInferenceCache::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+
+  // load the graph and create a session
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+
+  // prepare inputs
+  tensorflow::Tensor input(tensorflow::DT_FLOAT, {1, 10});
+  float* d = input.flat<float>().data();
+  for (size_t i = 0; i < 10; i++, d++) {
+    *d = float(i);
+  }
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+  scale.scalar<float>()() = 1.0;
+
+  // keys depend on the model id and values
+  tensorflow::InferenceCache::Key key1 = tensorflow::InferenceCache::key("m", {{"input", input}}, {"output"});
+  tensorflow::InferenceCache::Key key2 = tensorflow::InferenceCache::key("m", {{"input", input}}, {"output"});
+  tensorflow::InferenceCache::Key key3 = tensorflow::InferenceCache::key("n", {{"input", input}}, {"output"});
+  CPPUNIT_ASSERT(key1 == key2);
+  CPPUNIT_ASSERT(!(key1 == key3));
+
+  // a cache with two entries in a single shard
+  tensorflow::InferenceCache cache(2, 0, 1);
+
+  // first run is a miss, second one a hit
+  std::vector<tensorflow::Tensor> outputs;
+  tensorflow::run(&cache, "m", session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+  outputs.clear();
+  tensorflow::run(&cache, "m", session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs.size() == 1);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+
+  tensorflow::InferenceCache::Stats stats = cache.stats();
+  CPPUNIT_ASSERT(stats.hits == 1);
+  CPPUNIT_ASSERT(stats.misses == 1);
+  CPPUNIT_ASSERT(stats.entries == 1);
+  CPPUNIT_ASSERT(stats.hitRate() == 0.5);
+
+  // different values lead to misses and evictions of the least recently used entry
+  for (float s : {2., 3.}) {
+    scale.scalar<float>()() = s;
+    outputs.clear();
+    tensorflow::run(&cache, "m", session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+    CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46. * s);
+  }
+  stats = cache.stats();
+  CPPUNIT_ASSERT(stats.misses == 3);
+  CPPUNIT_ASSERT(stats.evictions == 1);
+  CPPUNIT_ASSERT(stats.entries == 2);
+  CPPUNIT_ASSERT(stats.bytes == 8);
+
+  // stats are also accounted per model id, evictions count for the model of the evicted entry
+  outputs.clear();
+  tensorflow::run(&cache, "n", session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  stats = cache.stats("m");
+  CPPUNIT_ASSERT(stats.hits == 1);
+  CPPUNIT_ASSERT(stats.misses == 3);
+  CPPUNIT_ASSERT(stats.evictions == 2);
+  CPPUNIT_ASSERT(stats.entries == 1);
+  CPPUNIT_ASSERT(stats.bytes == 4);
+  stats = cache.stats("n");
+  CPPUNIT_ASSERT(stats.hits == 0);
+  CPPUNIT_ASSERT(stats.misses == 1);
+  CPPUNIT_ASSERT(stats.evictions == 0);
+  CPPUNIT_ASSERT(stats.entries == 1);
+  CPPUNIT_ASSERT(cache.stats("o").misses == 0);
+  CPPUNIT_ASSERT(cache.stats().misses == 4);
+
+  // clear
+  cache.clear();
+  CPPUNIT_ASSERT(cache.stats().entries == 0);
+  CPPUNIT_ASSERT(cache.stats().hits == 0);
+  CPPUNIT_ASSERT(cache.stats("m").hits == 0);
+
+  // cleanup
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  delete graphDef;
+}
@@ -0,0 +1,126 @@
+/*
+ * Tests for memory accounting of sessions.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+#include "testBase.h"
+
+class testMemoryTracker : public testBase {
+  CPPUNIT_TEST_SUITE(testMemoryTracker);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testMemoryTracker);
+
+std::string testMemoryTracker::pyScript() const { return "createconstantgraph.py"; }
+
+void testMemoryTracker::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+
+  // enable tracking
+  tensorflow::MemoryTracker& tracker = tensorflow::MemoryTracker::instance();
+  tracker.setEnabled(true);
+  tracker.setTraceInterval(2);
+
+  // load the graph, weights consist of 10 + 1 floats
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+  CPPUNIT_ASSERT(tensorflow::estimateWeightBytes(*graphDef) == 44);
+
+  // create a session and check that it is tracked
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+  tracker.setSessionName(session, "constantgraph");
+  tensorflow::MemoryTracker::Stats stats = tracker.sessionStats(session);
+  CPPUNIT_ASSERT(stats.name == "constantgraph");
+  CPPUNIT_ASSERT(stats.weightBytes == 44);
+  CPPUNIT_ASSERT(stats.nRuns == 0);
+
+  // run three times, the first and third run are traced
+  tensorflow::Tensor input(tensorflow::DT_FLOAT, {1, 10});
+  float* d = input.flat<float>().data();
+  for (size_t i = 0; i < 10; i++, d++) {
+    *d = float(i);
+  }
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+  scale.scalar<float>()() = 1.0;
+
+  std::vector<tensorflow::Tensor> outputs;
+  for (size_t i = 0; i < 3; i++) {
+    tensorflow::run(session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+    CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+  }
+  stats = tracker.sessionStats(session);
+  CPPUNIT_ASSERT(stats.nRuns == 3);
+  CPPUNIT_ASSERT(stats.nTracedRuns == 2);
+  CPPUNIT_ASSERT(stats.peakRunBytes >= 4);
+  CPPUNIT_ASSERT(stats.peakBytes() >= stats.currentBytes());
+
+  // without runs in flight, only the weights are held
+  CPPUNIT_ASSERT(stats.reservedBytes == 0);
+  CPPUNIT_ASSERT(stats.currentBytes() == 44);
+  CPPUNIT_ASSERT(tracker.totalBytes() == stats.currentBytes());
+  CPPUNIT_ASSERT(tracker.modelStats().size() == 1);
+  tracker.report();
+
+  // runs and new sessions exceeding the budget fail
+  tracker.setBudget(stats.currentBytes() + 1);
+  CPPUNIT_ASSERT_THROW(tensorflow::run(session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs),
+                       cms::Exception);
+  CPPUNIT_ASSERT_THROW(tensorflow::createSession(graphDef), cms::Exception);
+  tracker.setBudget(0);
+  CPPUNIT_ASSERT(tracker.sessionStats(session).nRuns == 3);
+  CPPUNIT_ASSERT(tracker.totalBytes() == 44);
+
+  // reservations of runs in flight count towards the budget and are released when they end
+  tensorflow::int64 reservedBytes = 0;
+  tracker.beginRun(session, 100, &reservedBytes);
+  CPPUNIT_ASSERT(reservedBytes == stats.peakRunBytes + 100);
+  CPPUNIT_ASSERT(tracker.totalBytes() == 44 + reservedBytes);
+  tracker.setBudget(44 + 2 * reservedBytes - 1);
+  tensorflow::int64 otherReservedBytes = 0;
+  CPPUNIT_ASSERT_THROW(tracker.beginRun(session, 100, &otherReservedBytes), cms::Exception);
+  CPPUNIT_ASSERT(otherReservedBytes == 0);
+  tracker.setBudget(0);
+  tracker.endRun(session, nullptr, 0, reservedBytes);
+  CPPUNIT_ASSERT(tracker.totalBytes() == 44);
+
+  // reservations of failed runs are released as well
+  CPPUNIT_ASSERT_THROW(tensorflow::run(session, {{"input", input}, {"scale", scale}}, {"foo"}, &outputs),
+                       cms::Exception);
+  CPPUNIT_ASSERT(tracker.sessionStats(session).reservedBytes == 0);
+  CPPUNIT_ASSERT(tracker.totalBytes() == 44);
+
+  // sessions that fail to be created are not tracked
+  tensorflow::int64 totalBytes = tracker.totalBytes();
+  tensorflow::GraphDef invalidGraphDef(*graphDef);
+  tensorflow::NodeDef* node = invalidGraphDef.add_node();
+  node->set_name("foo");
+  node->set_op("FooOp");
+  CPPUNIT_ASSERT_THROW(tensorflow::createSession(&invalidGraphDef), cms::Exception);
+  CPPUNIT_ASSERT(tracker.totalBytes() == totalBytes);
+  CPPUNIT_ASSERT(tracker.modelStats().size() == 1);
+
+  // closed sessions are no longer tracked
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  CPPUNIT_ASSERT(tracker.totalBytes() == 0);
+  CPPUNIT_ASSERT_THROW(tracker.sessionStats(session), cms::Exception);
+
+  // cleanup
+  tracker.setEnabled(false);
+  delete graphDef;
+}
@@ -77,8 +77,42 @@ void testMetaGraphLoading::checkAll() {
   // check for exception
   CPPUNIT_ASSERT_THROW(tensorflow::run(session2, {{"foo", input}}, {"output"}, &outputs), cms::Exception);
 
+  // load the meta graph from a buffer, restoring variables from the export directory
+  std::string content;
+  CPPUNIT_ASSERT(tensorflow::ReadFileToString(
+                     tensorflow::Env::Default(), exportDir + "/" + tensorflow::kSavedModelFilenamePb, &content)
+                     .ok());
+  tensorflow::MetaGraphDef* bufferMetaGraphDef =
+      tensorflow::loadMetaGraphDefFromBuffer(content.data(), content.size());
+  CPPUNIT_ASSERT(bufferMetaGraphDef != nullptr);
+  CPPUNIT_ASSERT(bufferMetaGraphDef->graph_def().node_size() == metaGraphDef->graph_def().node_size());
+  CPPUNIT_ASSERT_THROW(tensorflow::loadMetaGraphDefFromBuffer(content.data(), content.size(), "foo"),
+                       cms::Exception);
+  tensorflow::Session* bufferSession = tensorflow::createSession(bufferMetaGraphDef, exportDir);
+  outputs.clear();
+  tensorflow::run(bufferSession, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+  CPPUNIT_ASSERT(tensorflow::closeSession(bufferSession));
+  delete bufferMetaGraphDef;
+
+  // create a session restoring only the variables required for the output
+  tensorflow::Session* session3 = tensorflow::createSession(metaGraphDef, exportDir, {"output"});
+  CPPUNIT_ASSERT(session3 != nullptr);
+  outputs.clear();
+  tensorflow::run(session3, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs.size() == 1);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+
+  // the scale does not depend on variables, so they remain uninitialized
+  tensorflow::Session* session4 = tensorflow::createSession(metaGraphDef, exportDir, {"scale"});
+  CPPUNIT_ASSERT(session4 != nullptr);
+  CPPUNIT_ASSERT_THROW(tensorflow::run(session4, {{"input", input}, {"scale", scale}}, {"output"}, &outputs),
+                       cms::Exception);
+
   // cleanup
   CPPUNIT_ASSERT(tensorflow::closeSession(session1));
   CPPUNIT_ASSERT(tensorflow::closeSession(session2));
+  CPPUNIT_ASSERT(tensorflow::closeSession(session3));
+  CPPUNIT_ASSERT(tensorflow::closeSession(session4));
   delete metaGraphDef;
 }
@@ -0,0 +1,84 @@
+/*
+ * Tests for the static cost analysis of graphs.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/ModelCost.h"
+
+#include "testBase.h"
+
+class testModelCost : public testBase {
+  CPPUNIT_TEST_SUITE(testModelCost);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testModelCost);
+
+std::string testModelCost::pyScript() const { return "createconstantgraph.py"; }
+
+void testModelCost::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+
+  // the scale has an unknown rank so its shape must be defined for a complete analysis
+  tensorflow::ModelCost cost = tensorflow::analyzeModelCost(*graphDef, 1);
+  CPPUNIT_ASSERT(!cost.complete);
+
+  // matmul of {1, 10} x {10, 1}, bias addition and scaling
+  cost = tensorflow::analyzeModelCost(*graphDef, 1, {{"scale", tensorflow::TensorShape({})}});
+  CPPUNIT_ASSERT(cost.complete);
+  CPPUNIT_ASSERT(cost.flops == 22);
+  CPPUNIT_ASSERT(cost.paramBytes == 44);
+  CPPUNIT_ASSERT(cost.paramBytes == tensorflow::estimateWeightBytes(*graphDef));
+
+  // the input and the matmul output are alive at the same time, weights are no activations
+  CPPUNIT_ASSERT(cost.peakActivationBytes >= 44);
+  CPPUNIT_ASSERT(cost.peakActivationBytes < 56);
+
+  // per op costs
+  bool foundMatMul = false;
+  for (const tensorflow::OpCost& opCost : cost.ops) {
+    if (opCost.op == "MatMul") {
+      foundMatMul = true;
+      CPPUNIT_ASSERT(opCost.flops == 20);
+      CPPUNIT_ASSERT(opCost.outputBytes == 4);
+    }
+  }
+  CPPUNIT_ASSERT(foundMatMul);
+
+  // compute scales with the batch size, parameters do not
+  tensorflow::ModelCost batchCost =
+      tensorflow::analyzeModelCost(*graphDef, 8, {{"scale", tensorflow::TensorShape({})}});
+  CPPUNIT_ASSERT(batchCost.flops == 8 * 22);
+  CPPUNIT_ASSERT(batchCost.flopsPerElement() == 22.);
+  CPPUNIT_ASSERT(batchCost.paramBytes == 44);
+  CPPUNIT_ASSERT(batchCost.peakActivationBytes > cost.peakActivationBytes);
+  CPPUNIT_ASSERT(batchCost.report().find("MatMul") != std::string::npos);
+
+  // placeholders without a shape attribute keep an unknown rank instead of becoming scalars
+  tensorflow::GraphDef noShapeGraphDef(*graphDef);
+  for (tensorflow::NodeDef& node : *noShapeGraphDef.mutable_node()) {
+    if (node.name() == "scale") {
+      node.mutable_attr()->erase("shape");
+    }
+  }
+  CPPUNIT_ASSERT(!tensorflow::analyzeModelCost(noShapeGraphDef, 1).complete);
+
+  CPPUNIT_ASSERT_THROW(tensorflow::analyzeModelCost(*graphDef, 0), cms::Exception);
+
+  delete graphDef;
+}
@@ -0,0 +1,99 @@
+/*
+ * Tests for evaluating constant graphs with the native evaluator.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/NativeGraph.h"
+
+#include "testBase.h"
+
+class testNativeGraph : public testBase {
+  CPPUNIT_TEST_SUITE(testNativeGraph);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testNativeGraph);
+
+std::string testNativeGraph::pyScript() const { return "createconstantgraph.py"; }
+
+void testNativeGraph::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+
+  // load the graph
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+
+  // compile the native graph, bias addition is fused into the matrix multiplication
+  tensorflow::NativeGraph* nativeGraph = tensorflow::createNativeGraph(graphDef, {"output"});
+  CPPUNIT_ASSERT(nativeGraph != nullptr);
+  CPPUNIT_ASSERT(nativeGraph->hasOutputs({"output:0"}));
+  CPPUNIT_ASSERT(!nativeGraph->hasOutputs({"foo"}));
+  CPPUNIT_ASSERT(nativeGraph->nSteps() == 2);
+
+  // unknown outputs cannot be compiled
+  CPPUNIT_ASSERT(tensorflow::createNativeGraph(graphDef, {"foo"}) == nullptr);
+  CPPUNIT_ASSERT_THROW(tensorflow::createNativeGraph(nullptr, {"output"}), cms::Exception);
+
+  // malformed nodes such as constants without values or nodes without inputs cannot be compiled
+  tensorflow::GraphDef noValuesGraphDef(*graphDef);
+  tensorflow::GraphDef noInputsGraphDef(*graphDef);
+  for (int i = 0; i < graphDef->node_size(); i++) {
+    noValuesGraphDef.mutable_node(i)->mutable_attr()->erase("value");
+    noInputsGraphDef.mutable_node(i)->clear_input();
+  }
+  CPPUNIT_ASSERT(tensorflow::createNativeGraph(&noValuesGraphDef, {"output"}) == nullptr);
+  CPPUNIT_ASSERT(tensorflow::createNativeGraph(&noInputsGraphDef, {"output"}) == nullptr);
+
+  // prepare inputs with two rows
+  tensorflow::Tensor input(tensorflow::DT_FLOAT, {2, 10});
+  float* d = input.flat<float>().data();
+  for (size_t i = 0; i < 20; i++, d++) {
+    *d = float(i % 10);
+  }
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+  scale.scalar<float>()() = 2.0;
+
+  // native evaluation
+  std::vector<tensorflow::Tensor> outputs;
+  nativeGraph->run({{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs.size() == 1);
+  std::cout << outputs[0].DebugString() << std::endl;
+  CPPUNIT_ASSERT(outputs[0].dim_size(0) == 2);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 92.);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(1, 0) == 92.);
+
+  // check for exception
+  CPPUNIT_ASSERT_THROW(nativeGraph->run({{"input", input}}, {"output"}, &outputs), cms::Exception);
+
+  // compare to the session, with and without fallback
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+  std::vector<tensorflow::Tensor> sessionOutputs;
+  tensorflow::run(session, {{"input", input}, {"scale", scale}}, {"output"}, &sessionOutputs);
+  CPPUNIT_ASSERT(sessionOutputs[0].matrix<float>()(0, 0) == outputs[0].matrix<float>()(0, 0));
+
+  outputs.clear();
+  tensorflow::run(nativeGraph, session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(1, 0) == 92.);
+
+  outputs.clear();
+  tensorflow::run(nullptr, session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(1, 0) == 92.);
+
+  // cleanup
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  delete nativeGraph;
+  delete graphDef;
+}
@@ -0,0 +1,118 @@
+/*
+ * Tests for the ops supported by the native evaluator, compared to the session output.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <cmath>
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/NativeGraph.h"
+
+#include "testBase.h"
+
+class testNativeGraphOps : public testBase {
+  CPPUNIT_TEST_SUITE(testNativeGraphOps);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+
+  void compare(const std::string& name,
+               const tensorflow::NamedTensorList& inputs,
+               const std::vector<std::string>& outputNames,
+               size_t nSteps = 0);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testNativeGraphOps);
+
+std::string testNativeGraphOps::pyScript() const { return "createnativegraphs.py"; }
+
+void testNativeGraphOps::compare(const std::string& name,
+                                 const tensorflow::NamedTensorList& inputs,
+                                 const std::vector<std::string>& outputNames,
+                                 size_t nSteps) {
+  std::cout << "comparing " << name << std::endl;
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(dataPath_ + "/" + name + ".pb");
+  CPPUNIT_ASSERT(graphDef != nullptr);
+
+  tensorflow::NativeGraph* nativeGraph = tensorflow::createNativeGraph(graphDef, outputNames);
+  CPPUNIT_ASSERT(nativeGraph != nullptr);
+  if (nSteps > 0) {
+    CPPUNIT_ASSERT(nativeGraph->nSteps() == nSteps);
+  }
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+
+  std::vector<tensorflow::Tensor> outputs;
+  nativeGraph->run(inputs, outputNames, &outputs);
+  std::vector<tensorflow::Tensor> sessionOutputs;
+  tensorflow::run(session, inputs, outputNames, &sessionOutputs);
+
+  // compare all values within a small tolerance
+  CPPUNIT_ASSERT(outputs.size() == sessionOutputs.size());
+  for (size_t i = 0; i < outputs.size(); i++) {
+    CPPUNIT_ASSERT(outputs[i].shape() == sessionOutputs[i].shape());
+    auto values = outputs[i].flat<float>();
+    auto sessionValues = sessionOutputs[i].flat<float>();
+    for (int j = 0; j < values.size(); j++) {
+      CPPUNIT_ASSERT(std::abs(values(j) - sessionValues(j)) <= 1e-5 * (1. + std::abs(sessionValues(j))));
+    }
+  }
+
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  delete nativeGraph;
+  delete graphDef;
+}
+
+void testNativeGraphOps::checkAll() {
+  tensorflow::setLogging();
+
+  // prepare inputs with three rows
+  tensorflow::Tensor input(tensorflow::DT_FLOAT, {3, 4});
+  float* d = input.flat<float>().data();
+  for (size_t i = 0; i < 12; i++, d++) {
+    *d = float(i) * 0.25 - 1.5;
+  }
+
+  // activations are fused into the dense step
+  for (const std::string act : {"relu", "relu6", "elu", "sigmoid", "tanh", "softmax"}) {
+    compare("native_" + act, {{"input", input}}, {"output"}, 1);
+  }
+
+  // concatenation of two branches
+  compare("native_concat", {{"input", input}}, {"output"});
+
+  // activations must not be fused in place when the layer output is read elsewhere, also via identities
+  compare("native_shared", {{"input", input}}, {"output", "output2"});
+  compare("native_shared_output", {{"input", input}}, {"output", "output2"});
+
+  // broadcast inputs are accepted as scalars, {n} or {1, n}
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+  scale.scalar<float>()() = 2.0;
+  compare("native_broadcast", {{"input", input}, {"scale", scale}}, {"output"});
+  tensorflow::Tensor rowScale(tensorflow::DT_FLOAT, {1, 4});
+  for (int i = 0; i < 4; i++) {
+    rowScale.matrix<float>()(0, i) = float(i) - 1.5;
+  }
+  compare("native_broadcast", {{"input", input}, {"scale", rowScale}}, {"output"});
+
+  // per-row values cannot be broadcasted row-wise, even when the number of elements matches
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(dataPath_ + "/native_broadcast.pb");
+  tensorflow::NativeGraph* nativeGraph = tensorflow::createNativeGraph(graphDef, {"output"});
+  CPPUNIT_ASSERT(nativeGraph != nullptr);
+  tensorflow::Tensor batchInput(tensorflow::DT_FLOAT, {4, 4});
+  batchInput.flat<float>().setConstant(1.0);
+  tensorflow::Tensor columnScale(tensorflow::DT_FLOAT, {4, 1});
+  columnScale.flat<float>().setConstant(2.0);
+  std::vector<tensorflow::Tensor> outputs;
+  CPPUNIT_ASSERT_THROW(nativeGraph->run({{"input", batchInput}, {"scale", columnScale}}, {"output"}, &outputs),
+                       cms::Exception);
+  delete nativeGraph;
+  delete graphDef;
+}
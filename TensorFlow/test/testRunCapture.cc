@@ -0,0 +1,108 @@
+/*
+ * Tests for capturing runs and reading them back.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/TensorFlow.h"
+
+#include "tensorflow/core/lib/io/compression.h"
+
+#include "testBase.h"
+
+class testRunCapture : public testBase {
+  CPPUNIT_TEST_SUITE(testRunCapture);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testRunCapture);
+
+std::string testRunCapture::pyScript() const { return "createconstantgraph.py"; }
+
+void testRunCapture::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+  std::string captureFile = dataPath_ + "/runs.tfrecord";
+
+  // load the graph and create a session
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+  tensorflow::Session* session = tensorflow::createSession(graphDef);
+  CPPUNIT_ASSERT(session != nullptr);
+
+  // prepare inputs
+  tensorflow::Tensor input(tensorflow::DT_FLOAT, {1, 10});
+  float* d = input.flat<float>().data();
+  for (size_t i = 0; i < 10; i++, d++) {
+    *d = float(i);
+  }
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+
+  // capture every second run of 3 runs with different scales
+  tensorflow::RunCapture& capture = tensorflow::RunCapture::instance();
+  capture.start(captureFile, 2);
+  capture.setSessionName(session, "constantgraph");
+  CPPUNIT_ASSERT(capture.active());
+  CPPUNIT_ASSERT_THROW(capture.start(captureFile), cms::Exception);
+  std::vector<tensorflow::Tensor> outputs;
+  for (float s : {1., 2., 3.}) {
+    scale.scalar<float>()() = s;
+    tensorflow::run(session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  }
+  CPPUNIT_ASSERT(capture.nRecorded() == 2);
+  capture.stop();
+  CPPUNIT_ASSERT(!capture.active());
+
+  // runs after stopping are not captured
+  tensorflow::run(session, {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+  CPPUNIT_ASSERT(capture.nRecorded() == 2);
+
+  // read back the first and third run and replay them
+  tensorflow::RunCaptureReader reader(captureFile);
+  tensorflow::CapturedRun capturedRun;
+  for (float s : {1., 3.}) {
+    CPPUNIT_ASSERT(reader.next(&capturedRun));
+    CPPUNIT_ASSERT(capturedRun.sessionName == "constantgraph");
+    CPPUNIT_ASSERT(capturedRun.durationNs > 0);
+    CPPUNIT_ASSERT(capturedRun.inputs.size() == 2);
+    CPPUNIT_ASSERT(capturedRun.inputs[0].first == "input");
+    CPPUNIT_ASSERT(capturedRun.inputs[0].second.shape() == input.shape());
+    CPPUNIT_ASSERT(capturedRun.inputs[0].second.matrix<float>()(0, 9) == 9.);
+    CPPUNIT_ASSERT(capturedRun.inputs[1].second.scalar<float>()() == s);
+    CPPUNIT_ASSERT(capturedRun.outputNames == std::vector<std::string>({"output"}));
+
+    tensorflow::run(session, capturedRun.inputs, capturedRun.outputNames, &outputs);
+    CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46. * s);
+  }
+  CPPUNIT_ASSERT(!reader.next(&capturedRun));
+
+  // records that cannot be parsed are not returned
+  std::string corruptedFile = dataPath_ + "/corrupted.tfrecord";
+  {
+    std::unique_ptr<tensorflow::WritableFile> file;
+    CPPUNIT_ASSERT(tensorflow::Env::Default()->NewWritableFile(corruptedFile, &file).ok());
+    tensorflow::io::RecordWriter writer(
+        file.get(), tensorflow::io::RecordWriterOptions::CreateRecordWriterOptions(tensorflow::io::compression::kZlib));
+    CPPUNIT_ASSERT(writer.WriteRecord("\x0d" "constantgraph" "\x01").ok());
+    CPPUNIT_ASSERT(writer.Close().ok());
+    CPPUNIT_ASSERT(file->Close().ok());
+  }
+  tensorflow::RunCaptureReader corruptedReader(corruptedFile);
+  CPPUNIT_ASSERT(!corruptedReader.next(&capturedRun));
+  CPPUNIT_ASSERT(capturedRun.durationNs == 0);
+  CPPUNIT_ASSERT_THROW(tensorflow::RunCaptureReader{dataPath_ + "/foo.tfrecord"}, cms::Exception);
+
+  // cleanup
+  CPPUNIT_ASSERT(tensorflow::closeSession(session));
+  delete graphDef;
+}
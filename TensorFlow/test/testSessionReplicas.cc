@@ -0,0 +1,130 @@
+/*
+ * Tests for NUMA-aware session replicas.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <dirent.h>
+#include <sched.h>
+
+#include <set>
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/SessionReplicas.h"
+
+#include "testBase.h"
+
+class testSessionReplicas : public testBase {
+  CPPUNIT_TEST_SUITE(testSessionReplicas);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  std::string pyScript() const override;
+  void checkAll() override;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testSessionReplicas);
+
+// returns the ids of all threads of the process
+std::set<int> threadIds() {
+  std::set<int> ids;
+  if (DIR* dir = opendir("/proc/self/task")) {
+    while (struct dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') {
+        ids.insert(std::stoi(entry->d_name));
+      }
+    }
+    closedir(dir);
+  }
+  return ids;
+}
+
+std::string testSessionReplicas::pyScript() const { return "createconstantgraph.py"; }
+
+void testSessionReplicas::checkAll() {
+  std::string pbFile = dataPath_ + "/constantgraph.pb";
+
+  // the topology always contains at least one node with cpus
+  std::vector<std::vector<int>> nodes = tensorflow::numaNodeCPUs();
+  CPPUNIT_ASSERT(!nodes.empty());
+  CPPUNIT_ASSERT(!nodes[0].empty());
+  std::cout << "found " << nodes.size() << " NUMA node(s)" << std::endl;
+
+  // load the graph
+  tensorflow::setLogging();
+  tensorflow::GraphDef* graphDef = tensorflow::loadGraphDef(pbFile);
+  CPPUNIT_ASSERT(graphDef != nullptr);
+
+  // create replicas, one per node
+  std::set<int> previousThreadIds = threadIds();
+  tensorflow::SessionReplicas replicas(graphDef);
+  CPPUNIT_ASSERT(replicas.size() == (nodes.size() > 1 ? nodes.size() : 1));
+  CPPUNIT_ASSERT(replicas.localReplica() < replicas.size());
+  CPPUNIT_ASSERT(replicas.session() != nullptr);
+
+  // each pinned replica spawns its own thread pool whose threads inherit the affinity of its node
+  for (size_t i = 0; i < replicas.size(); i++) {
+    if (replicas.cpus(i).empty()) {
+      continue;
+    }
+    cpu_set_t nodeMask;
+    CPU_ZERO(&nodeMask);
+    for (int cpu : replicas.cpus(i)) {
+      CPU_SET(cpu, &nodeMask);
+    }
+    bool found = false;
+    for (int id : threadIds()) {
+      cpu_set_t mask;
+      if (previousThreadIds.count(id) == 0 && sched_getaffinity(id, sizeof(mask), &mask) == 0 &&
+          CPU_EQUAL(&mask, &nodeMask)) {
+        found = true;
+        break;
+      }
+    }
+    std::cout << "replica " << i << " has " << (found ? "" : "no ") << "threads pinned to its node" << std::endl;
+    CPPUNIT_ASSERT(found);
+  }
+
+  // without NUMA awareness, there is always a single replica
+  tensorflow::SessionReplicas singleReplica(graphDef, 1, false);
+  CPPUNIT_ASSERT(singleReplica.size() == 1);
+  CPPUNIT_ASSERT(singleReplica.cpus(0).empty());
+
+  // prepare inputs
+  tensorflow::Tensor input(tensorflow::DT_FLOAT, {1, 10});
+  float* d = input.flat<float>().data();
+  for (size_t i = 0; i < 10; i++, d++) {
+    *d = float(i);
+  }
+  tensorflow::Tensor scale(tensorflow::DT_FLOAT, {});
+  scale.scalar<float>()() = 1.0;
+
+  // run the local replica with all thread pools
+  for (const std::string& threadPoolName : {"no_threads", "tbb", "tensorflow"}) {
+    std::vector<tensorflow::Tensor> outputs;
+    replicas.run({{"input", input}, {"scale", scale}}, {"output"}, &outputs, threadPoolName);
+    CPPUNIT_ASSERT(outputs.size() == 1);
+    CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+  }
+
+  // run all replicas explicitly
+  for (size_t i = 0; i < replicas.size(); i++) {
+    std::vector<tensorflow::Tensor> outputs;
+    tensorflow::run(replicas.session(i), {{"input", input}, {"scale", scale}}, {"output"}, &outputs);
+    CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+  }
+
+  // pinned thread pool
+  tensorflow::PinnedTBBThreadPool pool(nodes[0]);
+  CPPUNIT_ASSERT(pool.NumThreads() == int(nodes[0].size()));
+  std::vector<tensorflow::Tensor> outputs;
+  tensorflow::run(replicas.session(0), {{"input", input}, {"scale", scale}}, {"output"}, &outputs, &pool);
+  CPPUNIT_ASSERT(outputs[0].matrix<float>()(0, 0) == 46.);
+
+  // cleanup
+  delete graphDef;
+}
@@ -0,0 +1,70 @@
+/*
+ * Tests for the TBB-backed Eigen thread pool device, which runs independently of tfcompile'd
+ * functions by evaluating an Eigen tensor contraction that is parallelized by the device.
+ * Based on TensorFlow 2.1.
+ * For more info, see https://gitlab.cern.ch/mrieger/CMSSW-DNN.
+ *
+ * Author: Marcel Rieger
+ */
+
+#include <cmath>
+#include <stdexcept>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "PhysicsTools/TensorFlow/interface/TBBThreadPoolDevice.h"
+
+#include "tbb/parallel_for.h"
+
+class testTBBThreadPoolDevice : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(testTBBThreadPoolDevice);
+  CPPUNIT_TEST(checkAll);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void checkAll();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testTBBThreadPoolDevice);
+
+void testTBBThreadPoolDevice::checkAll() {
+  tensorflow::TBBThreadPoolDevice device(4);
+  CPPUNIT_ASSERT(device.NumThreads() == 4);
+  CPPUNIT_ASSERT(device.pool().GetNumScheduleCalled() == 0);
+
+  // a contraction large enough to be split into multiple tasks
+  const int n = 256;
+  Eigen::Tensor<float, 2> a(n, n);
+  Eigen::Tensor<float, 2> b(n, n);
+  a.setConstant(1.0f);
+  b.setConstant(2.0f);
+  Eigen::array<Eigen::IndexPair<int>, 1> dims = {Eigen::IndexPair<int>(1, 0)};
+
+  Eigen::Tensor<float, 2> c(n, n);
+  c.device(*device.device()) = a.contract(b, dims);
+  std::cout << "scheduled " << device.pool().GetNumScheduleCalled() << " tasks" << std::endl;
+  CPPUNIT_ASSERT(device.pool().GetNumScheduleCalled() > 0);
+  CPPUNIT_ASSERT(c(0, 0) == 2.0f * n);
+  CPPUNIT_ASSERT(c(n - 1, n - 1) == 2.0f * n);
+
+  // element-wise expressions are parallelized as well
+  int nScheduled = device.pool().GetNumScheduleCalled();
+  Eigen::Tensor<float, 2> d(n, n);
+  d.device(*device.device()) = (c + a).sqrt();
+  CPPUNIT_ASSERT(device.pool().GetNumScheduleCalled() > nScheduled);
+  CPPUNIT_ASSERT(d(n - 1, 0) == std::sqrt(2.0f * n + 1.0f));
+
+  // only threads running tasks of the pool have ids, which are in the range of the pool size
+  CPPUNIT_ASSERT(device.pool().CurrentThreadId() == -1);
+  int threadId = -2;
+  device.pool().Schedule([&]() { threadId = device.pool().CurrentThreadId(); });
+  CPPUNIT_ASSERT(threadId >= 0 && threadId < 4);
+
+  // tasks scheduled by threads of other arenas complete even when no TBB worker is available, as
+  // the calling thread takes part in the work
+  tbb::parallel_for(0, 16, [&](int) {
+    Eigen::Tensor<float, 2> e(n, n);
+    e.device(*device.device()) = a.contract(b, dims);
+    CPPUNIT_ASSERT(device.pool().CurrentThreadId() == -1);
+    CPPUNIT_ASSERT(e(n - 1, n - 1) == 2.0f * n);
+  });
+}